@@ -0,0 +1,132 @@
+#include <atomic>
+#include "esp_log.h"
+#include "esp_cpu.h"
+#include "driver/gptimer.h"
+#include "freertoscpp/freertos.hpp"
+#include "freertoscpp/freertos_task_factory.hpp"
+#include "freertoscpp/deferred_dispatcher.hpp"
+
+using augtons::freertos::task;
+using augtons::freertos::task_builder;
+using augtons::freertos::deferred_dispatcher;
+
+static const char *TAG = "DEFERRED";
+
+static constexpr uint32_t SAMPLES = 2000;
+static constexpr UBaseType_t HANDLER_PRIORITY = configMAX_PRIORITIES - 1;
+
+/**
+ * ISR-to-handler latency in CPU cycles. Only written by the handler side.
+ */
+struct latency_stats {
+    uint32_t min = UINT32_MAX;
+    uint32_t max = 0;
+    uint64_t sum = 0;
+    std::atomic<uint32_t> count { 0 };
+
+    void record(uint32_t cycles) {
+        if (cycles < min) {
+            min = cycles;
+        }
+        if (cycles > max) {
+            max = cycles;
+        }
+        sum += cycles;
+        count++;
+    }
+
+    void print(const char *name) const {
+        uint32_t n = count.load();
+        const uint32_t mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+        ESP_LOGI(TAG, "%-28s n=%lu min=%lu (%lu us) avg=%lu (%lu us) max=%lu (%lu us)", name, (unsigned long)n,
+                 (unsigned long)min, (unsigned long)(min / mhz),
+                 (unsigned long)(sum / n), (unsigned long)(sum / n / mhz),
+                 (unsigned long)max, (unsigned long)(max / mhz));
+    }
+};
+
+enum class mode { idle, notify, dispatcher };
+
+static std::atomic<mode> current_mode { mode::idle };
+static deferred_dispatcher<> *dispatcher = nullptr;
+static TaskHandle_t notify_handler = nullptr;
+static volatile uint32_t notify_start = 0;
+
+static latency_stats notify_stats;
+static latency_stats dispatcher_stats;
+
+static bool on_alarm(gptimer_handle_t, const gptimer_alarm_event_data_t *, void *) {
+    uint32_t start = esp_cpu_get_cycle_count();
+    BaseType_t woken = pdFALSE;
+    switch (current_mode.load()) {
+        case mode::notify:
+            // Baseline: raw task notification to a task waiting with the same priority as the worker.
+            notify_start = start;
+            vTaskNotifyGiveFromISR(notify_handler, &woken);
+            break;
+        case mode::dispatcher:
+            dispatcher->post_from_isr([start] {
+                dispatcher_stats.record(esp_cpu_get_cycle_count() - start);
+            }, &woken);
+            break;
+        default:
+            break;
+    }
+    return woken == pdTRUE;
+}
+
+static void wait_samples(const latency_stats& stats) {
+    while (stats.count.load() < SAMPLES) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+}
+
+extern "C" void app_main()
+{
+    // The timer interrupt is allocated on this core and the cycle counter is per core,
+    // so the baseline handler is pinned here too. The dispatcher serves the ISR's core by itself.
+    BaseType_t core = xPortGetCoreID();
+
+    static deferred_dispatcher<> d(HANDLER_PRIORITY);
+    dispatcher = &d;
+
+    task<> notify_task = task_builder<>("notify").stack(2048).priority(HANDLER_PRIORITY).core_id(core).bind([] {
+        while (true) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            notify_stats.record(esp_cpu_get_cycle_count() - notify_start);
+        }
+    });
+    notify_handler = notify_task.native_handle();
+
+    gptimer_handle_t timer = nullptr;
+    gptimer_config_t timer_config = {};
+    timer_config.clk_src = GPTIMER_CLK_SRC_DEFAULT;
+    timer_config.direction = GPTIMER_COUNT_UP;
+    timer_config.resolution_hz = 1000000;
+    ESP_ERROR_CHECK(gptimer_new_timer(&timer_config, &timer));
+
+    gptimer_event_callbacks_t callbacks = {};
+    callbacks.on_alarm = on_alarm;
+    ESP_ERROR_CHECK(gptimer_register_event_callbacks(timer, &callbacks, nullptr));
+    ESP_ERROR_CHECK(gptimer_enable(timer));
+
+    gptimer_alarm_config_t alarm = {};
+    alarm.alarm_count = 1000;   // 1 kHz
+    alarm.reload_count = 0;
+    alarm.flags.auto_reload_on_alarm = true;
+    ESP_ERROR_CHECK(gptimer_set_alarm_action(timer, &alarm));
+    ESP_ERROR_CHECK(gptimer_start(timer));
+
+    current_mode = mode::notify;
+    wait_samples(notify_stats);
+
+    current_mode = mode::dispatcher;
+    wait_samples(dispatcher_stats);
+
+    current_mode = mode::idle;
+    ESP_ERROR_CHECK(gptimer_stop(timer));
+
+    notify_stats.print("xTaskNotifyFromISR");
+    dispatcher_stats.print("deferred_dispatcher");
+    ESP_LOGI(TAG, "Dropped: %lu", (unsigned long)d.dropped());
+}
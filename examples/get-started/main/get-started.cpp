@@ -46,17 +46,18 @@ extern "C" void app_main()
     my_task1 = task_builder<>("my_task1_test2").stack(2048).priority(1).bind([]() {
         auto url = "www.baidu.com";
 
-        auto task = task_builder<>("temp").stack(2048).priority(0).bind([url]() {
+        auto task = task_builder<>("temp").stack(2048).priority(0).spawn([url]() {
             // Create a low-priority task, execute a time-consuming task.
-            // And signal an outer task through a task notification.
+            // Its return value is received through the join handle.
             ESP_LOGI(TAG, "Start! url = %s", url);
             vTaskDelay(pdMS_TO_TICKS(500));
-            xTaskNotifyGive((TaskHandle_t)my_task1);
+            return 200;
         });
 
         // Waiting for time-consuming task finish.
-        if(ulTaskNotifyTake(true, portMAX_DELAY) == pdTRUE) {
-            ESP_LOGI(TAG, "Finish");
+        int status = 0;
+        if (task.join_to(status)) {
+            ESP_LOGI(TAG, "Finish, status = %d", status);
         }
     });
 
@@ -0,0 +1,115 @@
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "esp_log.h"
+#include "freertoscpp/freertos.hpp"
+#include "freertoscpp/freertos_task_factory.hpp"
+#include "freertoscpp/queue.hpp"
+
+using augtons::freertos::task;
+using augtons::freertos::queue;
+using augtons::freertos::task_builder;
+using augtons::freertos::join_handle;
+
+static const char *TAG = "HANDLE_STRESS";
+
+static constexpr int WORKERS = 4;
+static constexpr int ROUNDS = 200;
+static constexpr int COPIES = 100;
+
+/**
+ * Every worker gets its own copy of `victim` and `q`, copies and destroys them concurrently,
+ * then all workers drop their last copy at the same time. The shared task and queue must be
+ * deleted exactly once: a double delete asserts inside FreeRTOS, a leak shows up in the checks below.
+ */
+static bool run_round(int round) {
+    auto guard = std::make_shared<int>(round);
+    std::weak_ptr<int> guard_alive = guard;
+
+    // Odd rounds race the last owner against the task returning by itself: the victim returns
+    // when the workers pass the barrier below, which is when they drop their last copies.
+    auto ready = std::make_shared<std::atomic<int>>(0);
+    bool finishes_by_itself = round % 2;
+    task<> victim = task_builder<>("victim").stack(2048).priority(2).bind([guard, ready, finishes_by_itself]() {
+        if (!finishes_by_itself) {
+            while (true) {
+                vTaskDelay(pdMS_TO_TICKS(1));
+            }
+        }
+        while (ready->load() < WORKERS) {
+            taskYIELD();
+        }
+    });
+    guard = nullptr;
+
+    queue<int> q(4);
+    q.send(round);
+    q.send(round + 1);
+
+    std::vector<join_handle<void>> workers;
+    for (int i = 0; i < WORKERS; i++) {
+        workers.push_back(task_builder<>("worker")
+            .stack(3072)
+            .priority(2)
+            .core_id(i % portNUM_PROCESSORS)
+            .spawn([victim, q, ready]() mutable {
+                for (int j = 0; j < COPIES; j++) {
+                    task<> a = victim;
+                    task<> b = a;
+                    a = nullptr;
+                    queue<int> qa = q;
+                    queue<int> qb = std::move(qa);
+                    if (j % 16 == 0) {
+                        taskYIELD();
+                    }
+                }
+                (*ready)++;
+                while (ready->load() < WORKERS) {
+                    taskYIELD();
+                }
+                victim = nullptr;
+                q = nullptr;
+            }));
+    }
+    victim = nullptr;
+    q = nullptr;
+
+    for (auto& w : workers) {
+        if (!w.join(pdMS_TO_TICKS(10000))) {
+            ESP_LOGE(TAG, "Round %d: worker did not finish.", round);
+            return false;
+        }
+    }
+    workers.clear();
+
+    if (!guard_alive.expired()) {
+        ESP_LOGE(TAG, "Round %d: shared task data leaked.", round);
+        return false;
+    }
+    return true;
+}
+
+extern "C" void app_main()
+{
+    vTaskDelay(pdMS_TO_TICKS(100));
+    UBaseType_t tasks_before = uxTaskGetNumberOfTasks();
+
+    bool ok = true;
+    for (int round = 0; round < ROUNDS && ok; round++) {
+        ok = run_round(round);
+    }
+
+    // Let the idle task free the deleted tasks.
+    vTaskDelay(pdMS_TO_TICKS(100));
+    UBaseType_t tasks_after = uxTaskGetNumberOfTasks();
+    if (tasks_after != tasks_before) {
+        ESP_LOGE(TAG, "Task count changed from %u to %u.", (unsigned)tasks_before, (unsigned)tasks_after);
+        ok = false;
+    }
+
+    if (!ok) {
+        ESP_LOGE(TAG, "FAILED");
+        abort();
+    }
+    ESP_LOGI(TAG, "PASSED, %d rounds with %d workers.", ROUNDS, WORKERS);
+}
@@ -0,0 +1,148 @@
+/*
+ * Throughput regressions. Each wrapper is measured against what it wraps in the same process,
+ * so the ratio does not depend on the speed of the machine running the test.
+ *
+ * This is a project of its own on purpose: the scheduling hooks of example `linux_sim` would be
+ * measured too, and they cannot be left out of a single translation unit of that project, because
+ * the inline functions of the library must be compiled the same way in the whole program.
+ */
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+#include "esp_log.h"
+#include "freertoscpp/freertos.hpp"
+#include "freertoscpp/freertos_task_factory.hpp"
+#include "freertoscpp/queue.hpp"
+#include "freertoscpp/semphr.hpp"
+
+using augtons::freertos::task;
+using augtons::freertos::queue;
+using augtons::freertos::task_builder;
+using augtons::freertos::generic_mutex;
+using augtons::freertos::mutex_locker;
+
+static const char *TAG = "LINUX_BENCH";
+
+static constexpr int OPS = 20000;
+static constexpr int TASK_OPS = 200;        // Every task creation starts a thread on the host.
+static constexpr int REPEAT = 5;
+
+template<typename Func>
+static double best_ops_per_second(int ops, Func func) {
+    double best = 0;
+    for (int r = 0; r < REPEAT; r++) {
+        auto start = std::chrono::steady_clock::now();
+        func();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        double rate = ops / (elapsed.count() > 0 ? elapsed.count() : 1e-9);
+        best = rate > best ? rate : best;
+    }
+    return best;
+}
+
+static bool check_ratio(const char *name, double wrapped, double raw, double min_ratio) {
+    double ratio = wrapped / raw;
+    bool ok = ratio >= min_ratio;
+    if (ok) {
+        ESP_LOGI(TAG, "%s: %.0f ops/s, %.2fx of the baseline (minimum %.2f).", name, wrapped, ratio, min_ratio);
+    } else {
+        ESP_LOGE(TAG, "%s: %.0f ops/s, %.2fx of the baseline, below %.2f.", name, wrapped, ratio, min_ratio);
+    }
+    return ok;
+}
+
+static void idle_forever(void*) {
+    while (true) {
+        vTaskDelay(portMAX_DELAY);
+    }
+}
+
+static bool throughput() {
+    bool ok = true;
+
+    // queue<T> allocates every message, the raw queue passes the same pointer back and forth.
+    {
+        queue<int> q(8);
+        QueueHandle_t raw = xQueueCreate(8, sizeof(int*));
+        int value = 0;
+        int *p = &value;
+        double wrapped = best_ops_per_second(OPS, [&] {
+            int out = 0;
+            for (int i = 0; i < OPS; i++) {
+                q.send(i, 0);
+                q.receive_to(out, 0);
+            }
+        });
+        double native = best_ops_per_second(OPS, [&] {
+            int *out = nullptr;
+            for (int i = 0; i < OPS; i++) {
+                xQueueSend(raw, &p, 0);
+                xQueueReceive(raw, &out, 0);
+            }
+        });
+        vQueueDelete(raw);
+        ok &= check_ratio("queue<int> send/receive", wrapped, native, 0.35);
+    }
+
+    // mutex_locker adds nothing but the RAII wrapper around take/give.
+    {
+        generic_mutex mutex;
+        SemaphoreHandle_t raw = xSemaphoreCreateMutex();
+        double wrapped = best_ops_per_second(OPS, [&] {
+            for (int i = 0; i < OPS; i++) {
+                mutex_locker<generic_mutex> lock(mutex);
+            }
+        });
+        double native = best_ops_per_second(OPS, [&] {
+            for (int i = 0; i < OPS; i++) {
+                xSemaphoreTake(raw, portMAX_DELAY);
+                xSemaphoreGive(raw);
+            }
+        });
+        vSemaphoreDelete(raw);
+        ok &= check_ratio("mutex_locker", wrapped, native, 0.80);
+    }
+
+    // Creating and deleting a task<> adds the shared data, the std::function and the deletion claim
+    // to xTaskCreate()/vTaskDelete(). The tasks have the idle priority, so none of them runs in between.
+    {
+        double wrapped = best_ops_per_second(TASK_OPS, [&] {
+            for (int i = 0; i < TASK_OPS; i++) {
+                task<> t = task_builder<>("bench").stack(2048).priority(tskIDLE_PRIORITY).bind([]() {
+                    idle_forever(nullptr);
+                });
+                t = nullptr;
+            }
+        });
+        double native = best_ops_per_second(TASK_OPS, [&] {
+            for (int i = 0; i < TASK_OPS; i++) {
+                TaskHandle_t handle = nullptr;
+                xTaskCreatePinnedToCore(idle_forever, "bench", 2048, nullptr, tskIDLE_PRIORITY,
+                                        &handle, tskNO_AFFINITY);
+                vTaskDelete(handle);
+            }
+        });
+        ok &= check_ratio("task<> create/delete", wrapped, native, 0.80);
+    }
+    return ok;
+}
+
+extern "C" void app_main()
+{
+    vTaskDelay(pdMS_TO_TICKS(100));
+
+    bool ok = throughput();
+
+    if (!ok) {
+        ESP_LOGE(TAG, "FAILED");
+#ifdef CONFIG_IDF_TARGET_LINUX
+        exit(1);
+#else
+        abort();
+#endif
+    }
+    ESP_LOGI(TAG, "PASSED");
+#ifdef CONFIG_IDF_TARGET_LINUX
+    exit(0);
+#endif
+}
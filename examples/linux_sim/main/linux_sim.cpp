@@ -0,0 +1,307 @@
+#include "sim.hpp"   // First: defines the scheduling hooks of FreeRTOS-Cpp.
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+#include "esp_log.h"
+#include "freertoscpp/freertos.hpp"
+#include "freertoscpp/freertos_task_factory.hpp"
+#include "freertoscpp/queue.hpp"
+#include "freertoscpp/semphr.hpp"
+
+using augtons::freertos::task;
+using augtons::freertos::queue;
+using augtons::freertos::task_builder;
+using augtons::freertos::generic_mutex;
+using augtons::freertos::mutex_locker;
+
+static const char *TAG = "LINUX_SIM";
+
+static constexpr uint32_t SEEDS = 200;
+static constexpr uint32_t REPLAY_SEED = 0;     // Set to a failing seed to replay only that interleaving.
+
+/**
+ * Counts live instances, so leaked or twice-deleted queue messages show up.
+ */
+struct tracked {
+    static std::atomic<int> live;
+    int value = 0;
+
+    tracked() { live++; }
+    explicit tracked(int value): value(value) { live++; }
+    tracked(const tracked& other): value(other.value) { live++; }
+    tracked(tracked&& other) noexcept: value(other.value) { live++; }
+    tracked& operator=(const tracked&) = default;
+    tracked& operator=(tracked&&) noexcept = default;
+    ~tracked() { live--; }
+};
+
+std::atomic<int> tracked::live { 0 };
+
+/* ---------------------------------------------------------------------------------------------
+ * Interleaving scenarios. Each returns true if its invariants hold for the interleaving of `seed`.
+ * ------------------------------------------------------------------------------------------- */
+
+/**
+ * Participants copy, move and drop handles to one task and one queue. Both must be deleted
+ * exactly once, by whichever participant drops the last reference.
+ */
+static bool handle_lifetime(uint32_t seed, sim::result& res) {
+    auto guard = std::make_shared<int>(0);
+    std::weak_ptr<int> guard_alive = guard;
+    task<> victim = task_builder<>("victim").stack(2048).priority(1).bind([guard]() {
+        while (true) {
+            vTaskDelay(portMAX_DELAY);
+        }
+    });
+    guard = nullptr;
+
+    {
+        queue<tracked> q(4);
+        q.send(tracked(1));
+        q.send(tracked(2));
+
+        std::vector<std::function<void()>> participants;
+        for (int i = 0; i < 3; i++) {
+            participants.emplace_back([victim, q, i]() mutable {
+                for (int j = 0; j < 3; j++) {
+                    task<> a = victim;
+                    sim::point("copy");
+                    task<> b = std::move(a);
+                    queue<tracked> qa = q;
+                    sim::point("copy");
+                    if ((i + j) % 2 == 0) {
+                        victim = nullptr;   // Drop the own reference early in some rounds.
+                        victim = b;
+                    }
+                    qa = nullptr;
+                }
+                victim = nullptr;
+                q = nullptr;
+            });
+        }
+        victim = nullptr;
+        q = nullptr;
+        res = sim::run(seed, std::move(participants));
+    }
+
+    if (!res.finished) {
+        return false;
+    }
+    if (!guard_alive.expired()) {
+        ESP_LOGE(TAG, "Seed %lu: task was not deleted.", (unsigned long)seed);
+        return false;
+    }
+    if (tracked::live.load() != 0) {
+        ESP_LOGE(TAG, "Seed %lu: %d queue messages leaked.", (unsigned long)seed, tracked::live.load());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * The function of the victim returns while participants still copy and drop handles to it.
+ * Whether the victim or the participant dropping the last reference deletes the task,
+ * it must be deleted exactly once and its function (with the captures) freed.
+ */
+static bool returning_task(uint32_t seed, sim::result& res) {
+    auto guard = std::make_shared<int>(0);
+    std::weak_ptr<int> guard_alive = guard;
+    auto returned = std::make_shared<bool>(false);
+    task<> victim;
+    {
+        sim::attachment turns;
+        victim = task_builder<>("victim").stack(4096).priority(1).bind([guard, returned, turns]() {
+            turns.join();
+            sim::point("victim.work");
+            *returned = true;
+        });
+    }
+    guard = nullptr;
+
+    std::vector<std::function<void()>> participants;
+    for (int i = 0; i < 3; i++) {
+        participants.emplace_back([victim, returned, i]() mutable {
+            // Keep a reference until the function has returned, so the end of the task is what races.
+            while (!*returned) {
+                task<> a = victim;
+                sim::point("copy");
+            }
+            if (i != 0) {
+                task<> a = victim;
+                sim::point("copy");
+            }
+            victim = nullptr;
+        });
+    }
+    victim = nullptr;
+    res = sim::run(seed, std::move(participants), 1);
+
+    if (!res.finished) {
+        return false;
+    }
+    if (!guard_alive.expired()) {
+        ESP_LOGE(TAG, "Seed %lu: returned task was not deleted.", (unsigned long)seed);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Two producers and one consumer pass ownership of messages through a short queue with
+ * blocking calls. The last message is left in the queue and must be freed with it.
+ */
+static bool queue_transfer(uint32_t seed, sim::result& res) {
+    constexpr int PER_PRODUCER = 6;
+    constexpr int TOTAL = 2 * PER_PRODUCER;
+    uint32_t received_mask = 0;
+    int received = 0;
+
+    {
+        queue<tracked> q(2);
+        std::vector<std::function<void()>> participants;
+        for (int p = 0; p < 2; p++) {
+            participants.emplace_back([q, p]() mutable {
+                for (int i = 0; i < PER_PRODUCER; i++) {
+                    q.send(tracked(p * PER_PRODUCER + i));
+                }
+                q = nullptr;
+            });
+        }
+        participants.emplace_back([q, &received_mask, &received]() mutable {
+            tracked item;
+            for (int i = 0; i < TOTAL - 1; i++) {
+                if (q.receive_to(item)) {
+                    received_mask |= 1u << item.value;
+                    received++;
+                }
+            }
+            q = nullptr;
+        });
+        q = nullptr;
+        res = sim::run(seed, std::move(participants));
+    }
+
+    if (!res.finished) {
+        return false;
+    }
+    if (received != TOTAL - 1 || __builtin_popcount(received_mask) != TOTAL - 1) {
+        ESP_LOGE(TAG, "Seed %lu: received %d messages, %d distinct.",
+                 (unsigned long)seed, received, __builtin_popcount(received_mask));
+        return false;
+    }
+    if (tracked::live.load() != 0) {
+        ESP_LOGE(TAG, "Seed %lu: %d queue messages leaked.", (unsigned long)seed, tracked::live.load());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Participants increment a counter in a read-modify-write with a scheduling point in the middle.
+ * With `locked` every update is kept, without it the harness is expected to find lost updates.
+ */
+static bool counter_updates(uint32_t seed, bool locked, sim::result& res) {
+    constexpr int PARTICIPANTS = 3;
+    constexpr int ROUNDS = 4;
+    generic_mutex mutex;
+    int counter = 0;
+
+    std::vector<std::function<void()>> participants;
+    for (int p = 0; p < PARTICIPANTS; p++) {
+        participants.emplace_back([&mutex, &counter, locked]() {
+            for (int i = 0; i < ROUNDS; i++) {
+                if (locked) {
+                    mutex_locker<generic_mutex> lock(mutex);
+                    int value = counter;
+                    sim::point("counter.read");
+                    counter = value + 1;
+                } else {
+                    int value = counter;
+                    sim::point("counter.read");
+                    counter = value + 1;
+                }
+            }
+        });
+    }
+    res = sim::run(seed, std::move(participants));
+    return res.finished && counter == PARTICIPANTS * ROUNDS;
+}
+
+/**
+ * Runs `scenario` for every seed, twice each: an interleaving must reproduce exactly.
+ */
+template<typename Scenario>
+static bool explore(const char *name, Scenario scenario) {
+    uint32_t first = REPLAY_SEED != 0 ? REPLAY_SEED : 1;
+    uint32_t last = REPLAY_SEED != 0 ? REPLAY_SEED : SEEDS;
+    uint64_t switches = 0;
+    for (uint32_t seed = first; seed <= last; seed++) {
+        sim::result a, b;
+        if (!scenario(seed, a)) {
+            ESP_LOGE(TAG, "%s: FAILED with seed %lu.", name, (unsigned long)seed);
+            return false;
+        }
+        if (!scenario(seed, b) || a.trace != b.trace) {
+            ESP_LOGE(TAG, "%s: seed %lu is not reproducible.", name, (unsigned long)seed);
+            return false;
+        }
+        switches += a.switches;
+    }
+    ESP_LOGI(TAG, "%s: %lu seeds, %llu context switches.", name,
+             (unsigned long)(last - first + 1), (unsigned long long)switches);
+    return true;
+}
+
+/**
+ * The unlocked counter has a lost update race. If no seed finds it, the harness does not interleave.
+ */
+static bool harness_finds_races() {
+    for (uint32_t seed = 1; seed <= SEEDS; seed++) {
+        sim::result res;
+        if (!counter_updates(seed, false, res)) {
+            if (!res.finished) {
+                return false;
+            }
+            ESP_LOGI(TAG, "Harness check: unlocked counter loses updates with seed %lu.", (unsigned long)seed);
+            return true;
+        }
+    }
+    ESP_LOGE(TAG, "Harness check: no seed found the lost update of the unlocked counter.");
+    return false;
+}
+
+extern "C" void app_main()
+{
+    vTaskDelay(pdMS_TO_TICKS(100));
+    UBaseType_t tasks_before = uxTaskGetNumberOfTasks();
+
+    bool ok = harness_finds_races();
+    ok = ok && explore("handle_lifetime", handle_lifetime);
+    ok = ok && explore("returning_task", returning_task);
+    ok = ok && explore("queue_transfer", queue_transfer);
+    ok = ok && explore("mutex_locker", [](uint32_t seed, sim::result& res) {
+        return counter_updates(seed, true, res);
+    });
+
+    // Let the idle task free the deleted tasks.
+    vTaskDelay(pdMS_TO_TICKS(100));
+    UBaseType_t tasks_after = uxTaskGetNumberOfTasks();
+    if (ok && tasks_after != tasks_before) {
+        ESP_LOGE(TAG, "Task count changed from %u to %u.", (unsigned)tasks_before, (unsigned)tasks_after);
+        ok = false;
+    }
+
+    if (!ok) {
+        ESP_LOGE(TAG, "FAILED");
+#ifdef CONFIG_IDF_TARGET_LINUX
+        exit(1);
+#else
+        abort();
+#endif
+    }
+    ESP_LOGI(TAG, "PASSED");
+#ifdef CONFIG_IDF_TARGET_LINUX
+    exit(0);
+#endif
+}
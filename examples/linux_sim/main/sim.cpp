@@ -0,0 +1,303 @@
+#include "sim.hpp"
+#include <atomic>
+#include <cstring>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertoscpp/freertos_task_factory.hpp"
+
+using augtons::freertos::task_builder;
+using augtons::freertos::join_handle;
+
+static const char *TAG = "SIM";
+
+namespace {
+    constexpr size_t MAX_PARTICIPANTS = 8;
+    constexpr UBaseType_t PRIORITY = 5;
+    constexpr UBaseType_t BLOCKED_PRIORITY = PRIORITY + 1;
+
+    enum class state_t { idle, parked, running, blocked, done };
+
+    struct participant {
+        TaskHandle_t handle = nullptr;
+        state_t state = state_t::idle;
+    };
+
+    portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+    participant parts[MAX_PARTICIPANTS];
+    size_t count = 0;
+    size_t spawned = 0;                 // Participants of `run()`, the attached ones follow them.
+    size_t attached_next = 0;
+    uint32_t generation = 0;            // Counts runs, so a late attachment cannot touch a later run.
+    std::atomic<int> owner { -1 };      // Participant whose turn it is, -1 before the start.
+    std::atomic<size_t> registered { 0 };
+    std::atomic<bool> active { false };
+    uint32_t rng = 0;
+    sim::result current;
+
+    uint32_t next_random() {
+        // xorshift32
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        return rng;
+    }
+
+    void hash(int self, const char *name) {
+        // FNV-1a over the participant and the name of the point.
+        uint32_t h = current.trace;
+        h = (h ^ (uint32_t)self) * 16777619u;
+        for (const char *c = name; *c != '\0'; c++) {
+            h = (h ^ (uint8_t)*c) * 16777619u;
+        }
+        current.trace = h;
+    }
+
+    int self_index() {
+        if (!active.load()) {
+            return -1;
+        }
+        TaskHandle_t me = xTaskGetCurrentTaskHandle();
+        for (size_t i = 0; i < count; i++) {
+            if (parts[i].handle == me && parts[i].state == state_t::running) {
+                return (int)i;
+            }
+        }
+        return -1;
+    }
+
+    // Picks the next owner among the parked participants. Called in the critical section.
+    int choose(int self) {
+        int candidates[MAX_PARTICIPANTS];
+        size_t n = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (parts[i].state == state_t::parked) {
+                candidates[n++] = (int)i;
+            }
+        }
+        int next = n == 0 ? -1 : candidates[next_random() % n];
+        if (next >= 0) {
+            parts[next].state = state_t::running;
+            if (next != self) {
+                current.switches++;
+            }
+        }
+        owner.store(next);
+        return next;
+    }
+
+    void wait_turn(int self) {
+        while (owner.load() != self) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+    }
+
+    void hand_over(int self, int next) {
+        if (next >= 0 && next != self) {
+            xTaskNotifyGive(parts[next].handle);
+        }
+    }
+
+    void enter(size_t index) {
+        portENTER_CRITICAL(&lock);
+        parts[index].handle = xTaskGetCurrentTaskHandle();
+        parts[index].state = state_t::parked;
+        portEXIT_CRITICAL(&lock);
+        registered++;
+        wait_turn((int)index);
+    }
+
+    void leave(size_t index) {
+        portENTER_CRITICAL(&lock);
+        parts[index].state = state_t::done;
+        int next = choose((int)index);
+        portEXIT_CRITICAL(&lock);
+        hand_over((int)index, next);
+    }
+
+    bool attached_done() {
+        bool done = true;
+        portENTER_CRITICAL(&lock);
+        for (size_t i = spawned; i < count; i++) {
+            done = done && parts[i].state == state_t::done;
+        }
+        portEXIT_CRITICAL(&lock);
+        return done;
+    }
+}
+
+struct sim::attachment_state {
+    int index = -1;
+    uint32_t generation = 0;
+
+    ~attachment_state() {
+        // Destroyed by another participant: it has deleted the attached task, which will never run again.
+        // Destroyed by the attached task itself: it still leaves at "task.exit".
+        if (index < 0) {
+            return;
+        }
+        portENTER_CRITICAL(&lock);
+        if (generation == ::generation && parts[index].handle != xTaskGetCurrentTaskHandle()) {
+            parts[index].state = state_t::done;
+        }
+        portEXIT_CRITICAL(&lock);
+    }
+};
+
+sim::attachment::attachment(): state(std::make_shared<attachment_state>()) {}
+
+void sim::attachment::join() const {
+    // The task may be created before `run()` has set up the participants.
+    while (!active.load()) {
+        vTaskDelay(1);
+    }
+    vTaskPrioritySet(nullptr, PRIORITY);
+    portENTER_CRITICAL(&lock);
+    size_t index = spawned + attached_next++;
+    state->generation = generation;
+    portEXIT_CRITICAL(&lock);
+    state->index = (int)index;
+    enter(index);
+}
+
+void sim::point(const char *name) {
+    int self = self_index();
+    if (self < 0) {
+        return;
+    }
+    if (strcmp(name, "task.exit") == 0) {
+        // An attached task deleting or suspending itself, it does not come back.
+        portENTER_CRITICAL(&lock);
+        hash(self, name);
+        portEXIT_CRITICAL(&lock);
+        leave(self);
+        return;
+    }
+    portENTER_CRITICAL(&lock);
+    hash(self, name);
+    parts[self].state = state_t::parked;
+    int next = choose(self);
+    portEXIT_CRITICAL(&lock);
+    if (next != self) {
+        hand_over(self, next);
+        wait_turn(self);
+    }
+}
+
+void sim::block_begin(const char *name) {
+    int self = self_index();
+    if (self < 0) {
+        return;
+    }
+    // Preempt the participant that unblocks us, so we queue up for a turn at a deterministic point.
+    vTaskPrioritySet(nullptr, BLOCKED_PRIORITY);
+    portENTER_CRITICAL(&lock);
+    hash(self, name);
+    parts[self].state = state_t::blocked;
+    int next = choose(self);
+    if (next < 0) {
+        // Nobody else can run. Keep the turn, so whoever we unblock does not race us for it.
+        owner.store(self);
+    }
+    portEXIT_CRITICAL(&lock);
+    hand_over(self, next);
+}
+
+void sim::block_end() {
+    if (!active.load()) {
+        return;
+    }
+    TaskHandle_t me = xTaskGetCurrentTaskHandle();
+    int self = -1;
+    bool take = false;
+    portENTER_CRITICAL(&lock);
+    for (size_t i = 0; i < count; i++) {
+        if (parts[i].handle == me && parts[i].state == state_t::blocked) {
+            self = (int)i;
+        }
+    }
+    if (self >= 0) {
+        if (owner.load() == self) {
+            take = true;
+            parts[self].state = state_t::running;
+            owner.store(self);
+        } else {
+            parts[self].state = state_t::parked;
+        }
+    }
+    portEXIT_CRITICAL(&lock);
+    if (self < 0) {
+        return;
+    }
+    vTaskPrioritySet(nullptr, PRIORITY);
+    if (!take) {
+        wait_turn(self);
+    }
+}
+
+sim::result sim::run(uint32_t seed, std::vector<std::function<void()>> participants, size_t attached) {
+    if (participants.size() + attached > MAX_PARTICIPANTS) {
+        ESP_LOGE(TAG, "At most %u participants.", (unsigned)MAX_PARTICIPANTS);
+        return result();
+    }
+
+    for (auto& p : parts) {
+        p = participant();
+    }
+    count = participants.size() + attached;
+    spawned = participants.size();
+    attached_next = 0;
+    generation++;
+    owner.store(-1);
+    registered.store(0);
+    rng = seed == 0 ? 0x9E3779B9u : seed;
+    current = result();
+    active.store(true);
+
+    std::vector<join_handle<void>> tasks;
+    for (size_t i = 0; i < participants.size(); i++) {
+        tasks.push_back(task_builder<>("sim")
+            .stack(8192)
+            .priority(PRIORITY)
+            .spawn([i, body = std::move(participants[i])]() mutable {
+                enter(i);
+                {
+                    // Destroy the captures while it is still our turn.
+                    std::function<void()> f = std::move(body);
+                    f();
+                }
+                leave(i);
+            }));
+    }
+
+    // Everyone is parked now, start the first participant.
+    while (registered.load() < count) {
+        vTaskDelay(1);
+    }
+    portENTER_CRITICAL(&lock);
+    int first = choose(-1);
+    portEXIT_CRITICAL(&lock);
+    hand_over(-1, first);
+
+    bool finished = true;
+    for (auto& t : tasks) {
+        if (!t.join(pdMS_TO_TICKS(5000))) {
+            finished = false;
+        }
+    }
+    // Attached tasks cannot be joined, wait until they are done.
+    for (int ms = 0; finished && !attached_done(); ms++) {
+        if (ms == 5000) {
+            finished = false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    if (!finished) {
+        ESP_LOGE(TAG, "Seed %lu: participants did not finish (deadlock?).", (unsigned long)seed);
+        // The stuck tasks keep their state, do not reuse the scheduler.
+        return current;
+    }
+    active.store(false);
+    current.finished = true;
+    return current;
+}
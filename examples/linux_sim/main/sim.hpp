@@ -0,0 +1,70 @@
+#ifndef LINUX_SIM_SIM_HPP
+#define LINUX_SIM_SIM_HPP
+
+/*
+ * Deterministic scheduler for tests. Include this before any FreeRTOS-Cpp header in every
+ * source file of the project, so the library's scheduling hooks call into it.
+ *
+ * Participants run one at a time. At every scheduling point the running participant hands
+ * over to one chosen by a seeded PRNG, so a seed always reproduces the same interleaving.
+ * Around blocking calls the participant gives up its turn and runs at a raised priority,
+ * which makes it wake up (and queue for its next turn) exactly when it is unblocked.
+ *
+ * Participants must not block outside of the hooks (no vTaskDelay(), no join()).
+ */
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace sim {
+    struct result {
+        bool finished = false;      // False on a deadlock or when a participant never finished.
+        uint32_t trace = 0;         // Hash of the sequence of scheduling decisions.
+        uint32_t switches = 0;
+    };
+
+    struct attachment_state;
+
+    /**
+     * Lets a FreeRTOS-Cpp task created outside of `run()` take part in it, so the end of its life
+     * (its function returning, deleting itself) is interleaved too. Capture an attachment in the
+     * function of the task and call `join()` first thing in it.
+     *
+     * The participant ends at the "task.exit" point, or when another participant deletes the task,
+     * which destroys the captured attachment.
+     */
+    class attachment {
+    private:
+        std::shared_ptr<attachment_state> state;
+
+    public:
+        attachment();
+        void join() const;
+    };
+
+    /**
+     * Runs every function of `participants` in its own task and interleaves them as chosen by `seed`,
+     * together with `attached` tasks joining through an `attachment`.
+     * The functions are destroyed by their task, so captured handles are released inside the run.
+     */
+    result run(uint32_t seed, std::vector<std::function<void()>> participants, size_t attached = 0);
+
+    void point(const char *name);
+    void block_begin(const char *name);
+    void block_end();
+
+    template<typename Call>
+    auto blocking(const char *name, Call&& call) -> decltype(call()) {
+        block_begin(name);
+        auto result = call();
+        block_end();
+        return result;
+    }
+}
+
+#define FREERTOS_CPP_SCHED_POINT(NAME) ::sim::point(NAME)
+#define FREERTOS_CPP_SCHED_BLOCKING(NAME, CALL) ::sim::blocking((NAME), [&]() { return (CALL); })
+
+#endif //LINUX_SIM_SIM_HPP
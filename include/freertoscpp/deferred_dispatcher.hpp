@@ -0,0 +1,164 @@
+#ifndef FREERTOS_CPP_DEFERRED_DISPATCHER_HPP
+#define FREERTOS_CPP_DEFERRED_DISPATCHER_HPP
+
+#include <atomic>
+#include <cstdio>
+#include "freertos.hpp"
+#include "freertos_task_factory.hpp"
+#include "mpsc_ring.hpp"
+
+/**
+ * Runs small callables posted from ISRs (or tasks) on a high-priority worker task, one worker per core.
+ *
+ * Each worker owns a preallocated lock-free ring of `Capacity` callables of at most `FunctorSize` bytes,
+ * so posting never allocates. An ISR posts to the worker of the core it runs on, and the worker is only
+ * notified when it is about to sleep.
+ *
+ * The workers are created in the constructor, so construct the dispatcher after the scheduler has started.
+ *
+ * ```
+ * static deferred_dispatcher<> *dispatcher;
+ *
+ * void IRAM_ATTR gpio_isr(void *arg) {
+ *     uint32_t level = gpio_get_level(GPIO_NUM_0);
+ *     dispatcher->post_from_isr([level] { handle_level(level); });
+ * }
+ *
+ * extern "C" void app_main() {
+ *     dispatcher = new deferred_dispatcher<>();
+ *     // Install the ISR ...
+ * }
+ * ```
+ *
+ * > Note: the dispatcher code is not placed in IRAM, don't post from ISRs that must run while the flash cache is disabled.
+ */
+template<size_t Capacity, size_t FunctorSize>
+class augtons::freertos::deferred_dispatcher {
+private:
+    using function = details::small_function<FunctorSize>;
+
+    struct worker {
+        details::mpsc_ring<function, Capacity> ring;
+        std::atomic<bool> idle { false };
+        std::atomic<uint32_t> dropped { 0 };
+        task<> worker_task;
+    };
+
+    worker workers[portNUM_PROCESSORS];
+
+    static void run(worker& w) {
+        while (true) {
+            while (w.ring.try_pop([](function& f) {
+                f();
+                f.reset();
+            })) {}
+
+            w.idle.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!w.ring.empty()) {
+                // Published between the last pop and going idle.
+                w.idle.store(false);
+                continue;
+            }
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            w.idle.store(false);
+        }
+    }
+
+    template<typename F>
+    bool push(worker& w, F&& func) {
+        if (!w.ring.try_push([&func](function& f) { f.emplace(std::forward<F>(func)); })) {
+            w.dropped++;
+            return false;
+        }
+        // Pairs with the fence in `run()`: either the worker sees the new element or we see it idle.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return true;
+    }
+
+    static BaseType_t current_core() {
+#if portNUM_PROCESSORS > 1
+        return xPortGetCoreID();
+#else
+        return 0;
+#endif
+    }
+
+public:
+    explicit deferred_dispatcher(UBaseType_t priority = configMAX_PRIORITIES - 1, uint32_t stack_size = 3072) {
+        for (BaseType_t core = 0; core < portNUM_PROCESSORS; core++) {
+            char name[CONFIG_FREERTOS_MAX_TASK_NAME_LEN + 1];
+            snprintf(name, sizeof(name), "deferred%d", (int)core);
+            worker *w = &workers[core];
+            w->worker_task = task_builder<>(name)
+                .stack(stack_size)
+                .priority(priority)
+                .core_id(portNUM_PROCESSORS > 1 ? core : tskNO_AFFINITY)
+                .bind([w] { run(*w); });
+            if (w->worker_task.is_null()) {
+                FreeRTOSCpp_LogE("Failed to create deferred dispatcher worker \"%s\".", name);
+            }
+        }
+    }
+
+    // Workers refer to this object.
+    deferred_dispatcher(const deferred_dispatcher&) = delete;
+    deferred_dispatcher& operator=(const deferred_dispatcher&) = delete;
+
+    /**
+     * Posts `func` to the worker of the current core from an ISR. Returns false if its ring is full.
+     *
+     * If `higher_priority_task_woken` is null a context switch is requested when the worker was woken,
+     * otherwise it is set like for other `...FromISR()` functions and the caller yields.
+     */
+    template<typename F>
+    bool post_from_isr(F&& func, BaseType_t *higher_priority_task_woken = nullptr) {
+        worker& w = workers[current_core()];
+        if (!push(w, std::forward<F>(func))) {
+            return false;
+        }
+        if (w.idle.exchange(false)) {
+            BaseType_t woken = pdFALSE;
+            vTaskNotifyGiveFromISR(w.worker_task.native_handle(), &woken);
+            if (higher_priority_task_woken != nullptr) {
+                *higher_priority_task_woken |= woken;
+            } else if (woken == pdTRUE) {
+                portYIELD_FROM_ISR();
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Posts `func` from task context to the worker of `core`, or of the current core by default.
+     * Returns false if the ring is full or `core` is not a valid core id.
+     */
+    template<typename F>
+    bool post(F&& func, BaseType_t core = tskNO_AFFINITY) {
+        if (core != tskNO_AFFINITY && (core < 0 || core >= portNUM_PROCESSORS)) {
+            FreeRTOSCpp_LogE("deferred_dispatcher::post() to invalid core %d.", (int)core);
+            return false;
+        }
+        worker& w = workers[core == tskNO_AFFINITY ? current_core() : core];
+        if (!push(w, std::forward<F>(func))) {
+            return false;
+        }
+        if (w.idle.exchange(false)) {
+            xTaskNotifyGive(w.worker_task.native_handle());
+        }
+        return true;
+    }
+
+    /**
+     * Number of callables dropped because a ring was full.
+     */
+    uint32_t dropped() const {
+        uint32_t sum = 0;
+        for (auto& w : workers) {
+            sum += w.dropped.load();
+        }
+        return sum;
+    }
+};
+
+#endif //FREERTOS_CPP_DEFERRED_DISPATCHER_HPP
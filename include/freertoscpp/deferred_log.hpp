@@ -0,0 +1,260 @@
+#ifndef FREERTOS_CPP_DEFERRED_LOG_HPP
+#define FREERTOS_CPP_DEFERRED_LOG_HPP
+
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mpsc_ring.hpp"
+
+#ifndef CONFIG_FREERTOS_CPP_DEFERRED_LOG_RING
+#define CONFIG_FREERTOS_CPP_DEFERRED_LOG_RING 32
+#endif
+
+/**
+ * Logs through `deferred_logger` when it is running and its ring has room, otherwise like `ESP_LOGx`.
+ * `LETTER` is the letter of `LEVEL`, as used by `LOG_FORMAT()`.
+ *
+ * ```
+ * FreeRTOSCpp_LogDeferred(ESP_LOG_INFO, I, "TAG", "value = %d", value);
+ * ```
+ */
+#define FreeRTOSCpp_LogDeferred(LEVEL, LETTER, TAG, FORMAT, ...)                                        \
+    do {                                                                                                \
+        if (LOG_LOCAL_LEVEL >= (LEVEL) && !::augtons::freertos::deferred_logger::write(                 \
+                (LEVEL), (TAG), LOG_FORMAT(LETTER, FORMAT), esp_log_timestamp(), ##__VA_ARGS__)) {      \
+            ESP_LOG_LEVEL_LOCAL((LEVEL), (TAG), FORMAT, ##__VA_ARGS__);                                 \
+        }                                                                                               \
+    } while (0)
+
+namespace augtons {
+    namespace freertos {
+        namespace details {
+            // `mpsc_ring` needs a power of two, the configured ring size is rounded up to one.
+            constexpr size_t round_up_pow2(size_t n) {
+                size_t p = 2;
+                while (p < n) {
+                    p <<= 1;
+                }
+                return p;
+            }
+
+            struct log_record {
+                static constexpr size_t args_size = 32;
+                static constexpr size_t strings_size = 48;
+
+                esp_log_level_t level = ESP_LOG_NONE;
+                const char *tag = nullptr;
+                const char *format = nullptr;
+                uint32_t timestamp = 0;
+                void (*emit)(const log_record&) = nullptr;
+                alignas(8) unsigned char args[args_size];
+                char strings[strings_size];     // Copies of string arguments, they may be gone when formatted.
+                size_t strings_used = 0;
+            };
+
+            // How an argument of type `T` is kept in a `log_record` until it is formatted.
+            template<typename T, typename = void>
+            struct log_arg {
+                static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value,
+                              "Deferred log arguments must be numbers, enums or pointers.");
+                using stored = T;
+
+                static stored capture(T value, log_record&) {
+                    return value;
+                }
+
+                static T restore(stored value, const log_record&) {
+                    return value;
+                }
+            };
+
+            template<typename T>
+            struct log_arg<T, typename std::enable_if<
+                    std::is_same<T, const char*>::value || std::is_same<T, char*>::value>::type> {
+                using stored = uint16_t;    // Offset into `log_record::strings`.
+
+                static stored capture(const char *str, log_record& record) {
+                    size_t offset = record.strings_used;
+                    size_t room = log_record::strings_size - offset;
+                    if (room == 0) {
+                        // Point at the terminator of the last copied string.
+                        return (stored)(log_record::strings_size - 1);
+                    }
+                    const char *src = str == nullptr ? "(null)" : str;
+                    size_t len = strnlen(src, room - 1);
+                    memcpy(record.strings + offset, src, len);
+                    record.strings[offset + len] = '\0';
+                    record.strings_used += len + 1;
+                    return (stored)offset;
+                }
+
+                static const char* restore(stored offset, const log_record& record) {
+                    return record.strings + offset;
+                }
+            };
+
+            template<typename... Args>
+            struct log_emitter {
+                using pack = std::tuple<typename log_arg<Args>::stored...>;
+                // Messages with more arguments than fit in a record are logged directly.
+                static constexpr bool fits = sizeof(pack) <= log_record::args_size && alignof(pack) <= 8;
+
+                static void capture(log_record& record, Args... args) {
+                    record.strings_used = 0;
+                    new (record.args) pack(log_arg<Args>::capture(args, record)...);
+                    record.emit = emit;
+                }
+
+                static void emit(const log_record& record) {
+                    emit(record, *reinterpret_cast<const pack*>(record.args), std::index_sequence_for<Args...>());
+                }
+
+                template<size_t... I>
+                static void emit(const log_record& record, const pack& args, std::index_sequence<I...>) {
+                    esp_log_write(record.level, record.tag, record.format, record.timestamp, record.tag,
+                                  log_arg<Args>::restore(std::get<I>(args), record)...);
+                }
+            };
+        }
+
+        /**
+         * Logs by copying the format pointer and the raw arguments into a lock-free ring of the current core.
+         * Formatting and printing happen later in a low-priority drain task, so logging costs a few
+         * stores instead of a `vprintf()` and UART output in the calling task.
+         *
+         * Formats must be string literals. String arguments are copied (up to 48 bytes per message in total),
+         * other arguments must be numbers, enums or pointers.
+         * Until `start()` is called, and while the ring of the current core is full, `write()` returns false
+         * and `FreeRTOSCpp_LogDeferred()` logs directly, so no message is lost.
+         */
+        class deferred_logger {
+        private:
+            using ring = details::mpsc_ring<details::log_record,
+                                            details::round_up_pow2(CONFIG_FREERTOS_CPP_DEFERRED_LOG_RING)>;
+
+            struct logger_state {
+                ring rings[portNUM_PROCESSORS];
+                std::atomic<TaskHandle_t> drain_task { nullptr };
+                std::atomic<uint32_t> overflowed { 0 };
+                TickType_t interval = 0;
+            };
+
+            static logger_state& state() {
+                static logger_state s;
+                return s;
+            }
+
+            static BaseType_t current_core() {
+#if portNUM_PROCESSORS > 1
+                return xPortGetCoreID();
+#else
+                return 0;
+#endif
+            }
+
+            static void drain(void *) {
+                auto& s = state();
+                while (true) {
+                    ulTaskNotifyTake(pdTRUE, s.interval);
+                    for (auto& r : s.rings) {
+                        while (r.try_pop([](details::log_record& record) {
+                            record.emit(record);
+                        })) {}
+                    }
+                }
+            }
+
+        public:
+            deferred_logger() = delete;
+
+            /**
+             * Starts the drain task, which prints pending messages every `interval` ticks.
+             */
+            static bool start(UBaseType_t priority = 1, uint32_t stack_size = 3072,
+                              TickType_t interval = pdMS_TO_TICKS(20)) {
+                auto& s = state();
+                if (s.drain_task.load() != nullptr) {
+                    return true;
+                }
+                s.interval = interval;
+                TaskHandle_t handle = nullptr;
+                if (xTaskCreatePinnedToCore(drain, "log_drain", stack_size, nullptr, priority,
+                                            &handle, tskNO_AFFINITY) != pdPASS) {
+                    ESP_LOGE("FreeRTOS-Cpp", "Failed to create the deferred log drain task.");
+                    return false;
+                }
+                s.drain_task.store(handle);
+                return true;
+            }
+
+            static bool is_running() {
+                return state().drain_task.load() != nullptr;
+            }
+
+            /**
+             * Wakes the drain task to print pending messages now.
+             */
+            static void flush() {
+                TaskHandle_t handle = state().drain_task.load();
+                if (handle != nullptr) {
+                    xTaskNotifyGive(handle);
+                }
+            }
+
+            /**
+             * Number of messages logged directly because the ring of their core was full.
+             * If it grows, increase `CONFIG_FREERTOS_CPP_DEFERRED_LOG_RING` or drain more often.
+             */
+            static uint32_t overflowed() {
+                return state().overflowed.load();
+            }
+
+            /**
+             * Queues a message. `format` must already contain the `LOG_FORMAT()` prefix, which takes
+             * `timestamp` and `tag` as its first two arguments. Returns false if the logger is not running
+             * or the ring is full, the caller then logs the message itself.
+             */
+            template<typename... Args>
+            static bool write(esp_log_level_t level, const char *tag, const char *format, uint32_t timestamp,
+                              Args... args) {
+                using emitter = details::log_emitter<typename std::decay<Args>::type...>;
+                if (state().drain_task.load(std::memory_order_relaxed) == nullptr) {
+                    return false;
+                }
+                return push<emitter>(std::integral_constant<bool, emitter::fits>(),
+                                     level, tag, format, timestamp, args...);
+            }
+
+        private:
+            template<typename Emitter, typename... Args>
+            static bool push(std::true_type, esp_log_level_t level, const char *tag, const char *format,
+                             uint32_t timestamp, Args... args) {
+                auto& s = state();
+                bool pushed = s.rings[current_core()].try_push([&](details::log_record& record) {
+                    record.level = level;
+                    record.tag = tag;
+                    record.format = format;
+                    record.timestamp = timestamp;
+                    Emitter::capture(record, args...);
+                });
+                if (!pushed) {
+                    s.overflowed++;
+                }
+                return pushed;
+            }
+
+            template<typename Emitter, typename... Args>
+            static bool push(std::false_type, esp_log_level_t, const char*, const char*, uint32_t, Args...) {
+                return false;
+            }
+        };
+    }
+}
+
+#endif //FREERTOS_CPP_DEFERRED_LOG_HPP
@@ -1,33 +1,77 @@
 #ifndef FREERTOS_CPP_HPP
 #define FREERTOS_CPP_HPP
 
+#include <atomic>
 #include <memory>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos_types.hpp"
+#include "stack_profiler.hpp"
+#include "memory_caps.hpp"
 
 namespace augtons {
     namespace freertos {
+        namespace details {
+            /**
+             * The first caller that switches `has_deleted` from false to true deletes the task,
+             * whether it is the task itself returning from its function or the last owner.
+             * Everything needed for the deletion must be read before, the winner of a concurrent
+             * owner may free the shared data as soon as it has lost.
+             */
+            inline bool claim_task_deletion(std::atomic<bool>& has_deleted, TaskHandle_t handle) {
+                FREERTOS_CPP_SCHED_POINT("task.delete");
+                return handle != nullptr && !has_deleted.exchange(true);
+            }
+
+            /**
+             * Deletes the task exactly once, see `claim_task_deletion()`.
+             */
+            inline void delete_task_once(std::atomic<bool>& has_deleted, TaskHandle_t handle,
+                                         uint32_t stack_size, uint32_t stack_caps) {
+                if (!claim_task_deletion(has_deleted, handle)) {
+                    return;
+                }
+                stack_profiler::record(handle, stack_size);
+                details::delete_task(handle, stack_caps);
+            }
+        }
+
         template<typename ArgType = void>
         struct task_shared_data {
-            bool has_deleted = false;
+            std::atomic<bool> has_deleted { false };
             TaskHandle_t task_handle = nullptr;
+            uint32_t stack_size = 0;
+            uint32_t stack_caps = 0;    // 0: stack from the default heap.
+            std::weak_ptr<task_shared_data> self;   // Lets the task take a reference when its function returns.
             FuncType_t<ArgType> function;
             ArgType args;
 
             explicit task_shared_data(const FuncType_t<ArgType>& function, InArgType<ArgType> args)
                 : function(function)
                 , args(std::forward<InArgType<ArgType>>(args)) {}
+
+            // Runs once, when the last `task<>` referring to it is destroyed.
+            ~task_shared_data() {
+                details::delete_task_once(has_deleted, task_handle, stack_size, stack_caps);
+            }
         };
 
         template<>
         struct task_shared_data<void> {
-            bool has_deleted = false;
+            std::atomic<bool> has_deleted { false };
             TaskHandle_t task_handle = nullptr;
+            uint32_t stack_size = 0;
+            uint32_t stack_caps = 0;    // 0: stack from the default heap.
+            std::weak_ptr<task_shared_data> self;   // Lets the task take a reference when its function returns.
             FuncType_t<void> function;
 
             explicit task_shared_data(const FuncType_t<>& function)
                 : function(function) {}
+
+            // Runs once, when the last `task<>` referring to it is destroyed.
+            ~task_shared_data() {
+                details::delete_task_once(has_deleted, task_handle, stack_size, stack_caps);
+            }
         };
 
         template<typename ArgType = void>
@@ -38,16 +82,42 @@ namespace augtons {
         namespace details {
             template<typename ArgType = void>
             void delete_task_from_shared_data(task_shared_data<ArgType>* data) {
-                auto handle = data->task_handle;
-                data->has_deleted = true;
-                data->task_handle = nullptr;
-                vTaskDelete(handle);
+                delete_task_once(data->has_deleted, data->task_handle, data->stack_size, data->stack_caps);
             }
 
             template<typename ArgType = void>
             inline void delete_task_from_shared_data(shared_task_data_ptr<ArgType> data) {
                 delete_task_from_shared_data(data.get());
             }
+
+            /**
+             * Called by the task itself after its function has returned. The owners may be dropping their
+             * references on another core meanwhile, so the deletion is decided while holding a reference.
+             * The shared data is alive up to here: an owner that wins stops this task before freeing it.
+             */
+            template<typename ArgType = void>
+            void delete_returned_task(task_shared_data<ArgType>* data) {
+                {
+                    shared_task_data_ptr<ArgType> keep = data->self.lock();
+                    if (keep != nullptr) {
+                        TaskHandle_t handle = keep->task_handle;
+                        uint32_t stack_size = keep->stack_size;
+                        uint32_t stack_caps = keep->stack_caps;
+                        if (claim_task_deletion(keep->has_deleted, handle)) {
+                            // May be the last reference, `~task_shared_data()` then finds the deletion claimed.
+                            keep = nullptr;
+                            stack_profiler::record(handle, stack_size);
+                            FREERTOS_CPP_SCHED_POINT("task.exit");
+                            details::delete_task(handle, stack_caps);
+                        }
+                    }
+                }
+                // The last owner is deleting this task concurrently, wait for it.
+                FREERTOS_CPP_SCHED_POINT("task.exit");
+                while (true) {
+                    vTaskSuspend(nullptr);
+                }
+            }
         }
     }
 }
@@ -61,25 +131,20 @@ private:
     explicit task(shared_task_data_ptr<Arg> data): shared_data(data) {}
 public:
     task() = default;
-    task(task&) = default;
+    task(const task&) = default;
     task(task&&) noexcept = default;
     task& operator=(const task&) = default;
     task& operator=(task&&) noexcept = default;
 
     task& operator=(nullptr_t) {
-        this->~task();
+        shared_data = nullptr;
         return *this;
     }
 
-    ~task() {
-        if (is_null()) {
-            return;
-        }
-        if (shared_data.use_count() <= 1 && !(shared_data->has_deleted)) {
-            delete_task();
-        }
-        shared_data = nullptr;
-    }
+    // The task is deleted by `~task_shared_data()` when the last owner goes away.
+    // Distinct `task` objects sharing one task may be copied and destroyed concurrently,
+    // a single `task` object must not be modified from several tasks at once.
+    ~task() = default;
 
     inline long use_count() const {
         if (is_null()) {
@@ -89,15 +154,22 @@ public:
     }
 
     inline bool is_null() const {
-        return shared_data == nullptr || shared_data->task_handle == nullptr;
+        return shared_data == nullptr || shared_data->task_handle == nullptr || shared_data->has_deleted.load();
     }
 
-    inline bool has_deleted() const {
+    inline uint32_t stack_size() const {
         if (is_null()) {
+            return 0;
+        }
+        return shared_data->stack_size;
+    }
+
+    inline bool has_deleted() const {
+        if (shared_data == nullptr || shared_data->task_handle == nullptr) {
             FreeRTOSCpp_LogW("Calling \"has_deleted()\" on a null task object always returns true.");
             return true;
         }
-        return shared_data->has_deleted;
+        return shared_data->has_deleted.load();
     }
 
     TaskHandle_t native_handle_not_null() const {
@@ -142,12 +214,8 @@ public:
             FreeRTOSCpp_LogW("Try to delete a task from a task object that is null.");
             return;
         }
-        if (has_deleted()) {
-            shared_data = nullptr;
-            return;
-        }
 
-        auto data = shared_data;
+        auto data = std::move(shared_data);
         shared_data = nullptr;
         details::delete_task_from_shared_data(data);
     }
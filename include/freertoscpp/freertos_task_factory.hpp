@@ -2,6 +2,8 @@
 #define FREERTOS_CPP_TASK_FACTORY_HPP
 
 #include "freertos.hpp"
+#include "join_handle.hpp"
+#include "periodic.hpp"
 #include "cstring"
 
 template<typename ArgType>
@@ -16,7 +18,8 @@ public:
             abort();
         }
         data->function(std::forward<ArgType>(data->args));
-        details::delete_task_from_shared_data(data);
+        FREERTOS_CPP_SCHED_POINT("task.return");
+        details::delete_returned_task(data);
     }
 
     static auto create(
@@ -25,14 +28,19 @@ public:
         const UBaseType_t priority,
         InArgType<ArgType> task_args,
         const Func& func,
-        BaseType_t core_id = tskNO_AFFINITY
+        BaseType_t core_id = tskNO_AFFINITY,
+        uint32_t stack_caps = 0
     ) -> task<ArgType> {
 
-        auto data = std::make_shared<task_shared_data<ArgType>>(func, std::forward<InArgType<ArgType>>(task_args));
+        auto data = std::allocate_shared<task_shared_data<ArgType>>(details::internal_allocator<task_shared_data<ArgType>>(),
+                                                                    func, std::forward<InArgType<ArgType>>(task_args));
         auto ret = task<ArgType>(data);
+        ret.shared_data->stack_size = stack_size;
+        ret.shared_data->stack_caps = stack_caps;
+        ret.shared_data->self = data;
 
-        if (xTaskCreatePinnedToCore(task_fun, name, stack_size, ret.shared_data.get(),
-                        priority, &ret.shared_data->task_handle, core_id) != pdPASS) {
+        if (details::create_task(task_fun, name, stack_size, ret.shared_data.get(),
+                                 priority, &ret.shared_data->task_handle, core_id, stack_caps) != pdPASS) {
             ret = nullptr;
         }
 
@@ -53,7 +61,8 @@ public:
             abort();
         }
         data->function();
-        details::delete_task_from_shared_data(data);
+        FREERTOS_CPP_SCHED_POINT("task.return");
+        details::delete_returned_task(data);
     }
 
     static auto create(
@@ -61,12 +70,16 @@ public:
         const uint32_t stack_size,
         const UBaseType_t priority,
         const Func& func,
-        BaseType_t core_id = tskNO_AFFINITY
+        BaseType_t core_id = tskNO_AFFINITY,
+        uint32_t stack_caps = 0
     ) -> task<> {
-        auto data = std::make_shared<task_shared_data<>>(func);
+        auto data = std::allocate_shared<task_shared_data<>>(details::internal_allocator<task_shared_data<>>(), func);
         auto ret = task<>(data);
-        if (xTaskCreatePinnedToCore(task_fun, name, stack_size, ret.shared_data.get(),
-                                    priority, &ret.shared_data->task_handle, core_id) != pdPASS) {
+        ret.shared_data->stack_size = stack_size;
+        ret.shared_data->stack_caps = stack_caps;
+        ret.shared_data->self = data;
+        if (details::create_task(task_fun, name, stack_size, ret.shared_data.get(),
+                                 priority, &ret.shared_data->task_handle, core_id, stack_caps) != pdPASS) {
             ret = nullptr;
         }
         return ret;
@@ -81,6 +94,7 @@ private:
     uint32_t m_stack_size_num = 0;
     UBaseType_t m_priority = 0;
     BaseType_t m_core_id = tskNO_AFFINITY;
+    uint32_t m_stack_caps = 0;
 public:
     explicit task_builder(const char *name) {
         strncpy(m_name, name, sizeof(m_name));
@@ -91,6 +105,15 @@ public:
         return *this;
     }
 
+    /**
+     * Uses the peak stack usage recorded by `stack_profiler` for this task name plus `margin`,
+     * or `fallback` when nothing has been recorded yet.
+     */
+    task_builder& stack_auto(uint32_t fallback, uint32_t margin = CONFIG_FREERTOS_CPP_STACK_AUTO_MARGIN) {
+        this->m_stack_size_num = stack_profiler::suggest(m_name, fallback, margin);
+        return *this;
+    }
+
     task_builder& priority(UBaseType_t p) {
         this->m_priority = p;
         return *this;
@@ -101,8 +124,51 @@ public:
         return *this;
     }
 
+    /**
+     * Allocates the stack from memory with capabilities `caps`, e.g. `MALLOC_CAP_SPIRAM`
+     * (needs ESP-IDF v5.1 and `CONFIG_SPIRAM_ALLOW_STACK_EXTERNAL_MEMORY` for PSRAM).
+     * The TCB and the shared data of the task stay in internal RAM.
+     */
+    task_builder& stack_caps(uint32_t caps) {
+        m_stack_caps = caps;
+        return *this;
+    }
+
     task<> bind(const Func& func) {
-        return task_factory<>::create(m_name, m_stack_size_num, m_priority, func, m_core_id);
+        return task_factory<>::create(m_name, m_stack_size_num, m_priority, func, m_core_id, m_stack_caps);
+    }
+
+    /**
+     * Calls `func` every `period` ticks, measured from release to release with `xTaskDelayUntil()`.
+     * Overruns, execution time and release jitter are recorded in the returned `periodic_task`.
+     */
+    periodic_task bind_periodic(TickType_t period, const Func& func) {
+        auto state = std::make_shared<details::periodic_state>(period);
+        auto t = bind([state, func]() {
+            details::run_periodic(*state, func);
+        });
+        return periodic_task(std::move(t), std::move(state));
+    }
+
+    /**
+     * Like `bind()`, but the return value of `func` can be received through the returned `join_handle`.
+     * `func` may take a `stop_token` to observe `join_handle::request_stop()`.
+     */
+    template<typename F>
+    auto spawn(F func) -> join_handle<typename details::spawn_result<F>::type> {
+        using R = typename details::spawn_result<F>::type;
+        using WithToken = std::integral_constant<bool, details::accepts_stop_token<F>::value>;
+
+        auto state = std::make_shared<details::join_state<R>>();
+        auto t = bind([state, func]() mutable {
+            details::spawn_invoker<R>::run(*state, func, stop_token(state), WithToken());
+            state->finish();
+        });
+        if (t.is_null() && !state->is_finished()) {
+            FreeRTOSCpp_LogE("Failed to create task \"%s\" for spawn().", m_name);
+            return join_handle<R>();
+        }
+        return join_handle<R>(std::move(t), std::move(state));
     }
 };
 
@@ -113,6 +179,7 @@ class augtons::freertos::task_builder {
     uint32_t m_stack_size_num = 0;
     UBaseType_t m_priority = 0;
     BaseType_t m_core_id = tskNO_AFFINITY;
+    uint32_t m_stack_caps = 0;
 public:
     explicit task_builder(const char *name) {
         strncpy(m_name, name, sizeof(m_name));
@@ -123,6 +190,15 @@ public:
         return *this;
     }
 
+    /**
+     * Uses the peak stack usage recorded by `stack_profiler` for this task name plus `margin`,
+     * or `fallback` when nothing has been recorded yet.
+     */
+    task_builder& stack_auto(uint32_t fallback, uint32_t margin = CONFIG_FREERTOS_CPP_STACK_AUTO_MARGIN) {
+        this->m_stack_size_num = stack_profiler::suggest(m_name, fallback, margin);
+        return *this;
+    }
+
     task_builder& priority(UBaseType_t p) {
         this->m_priority = p;
         return *this;
@@ -133,9 +209,19 @@ public:
         return *this;
     }
 
+    /**
+     * Allocates the stack from memory with capabilities `caps`, e.g. `MALLOC_CAP_SPIRAM`
+     * (needs ESP-IDF v5.1 and `CONFIG_SPIRAM_ALLOW_STACK_EXTERNAL_MEMORY` for PSRAM).
+     * The TCB and the shared data of the task stay in internal RAM.
+     */
+    task_builder& stack_caps(uint32_t caps) {
+        m_stack_caps = caps;
+        return *this;
+    }
+
     task<ArgType> bind(InArgType<ArgType> arg, const Func& func) {
         return task_factory<ArgType>::create(m_name, m_stack_size_num, m_priority,
-                                             std::forward<InArgType<ArgType>>(arg), func, m_core_id);
+                                             std::forward<InArgType<ArgType>>(arg), func, m_core_id, m_stack_caps);
     }
 };
 
@@ -1,9 +1,26 @@
 #ifndef FREERTOS_CPP_TYPES_HPP
 #define FREERTOS_CPP_TYPES_HPP
 
+#include <cstddef>
 #include <functional>
 #include "esp_log.h"
 
+#ifdef CONFIG_FREERTOS_CPP_DEFERRED_LOG
+#include "deferred_log.hpp"
+
+#define FreeRTOSCpp_LogI(FORMAT, ...) \
+    FreeRTOSCpp_LogDeferred(ESP_LOG_INFO, I, "FreeRTOS-Cpp", FORMAT, ##__VA_ARGS__)
+
+#define FreeRTOSCpp_LogD(FORMAT, ...) \
+    FreeRTOSCpp_LogDeferred(ESP_LOG_DEBUG, D, "FreeRTOS-Cpp", FORMAT, ##__VA_ARGS__)
+
+#define FreeRTOSCpp_LogW(FORMAT, ...) \
+    FreeRTOSCpp_LogDeferred(ESP_LOG_WARN, W, "FreeRTOS-Cpp", FORMAT, ##__VA_ARGS__)
+
+// Errors are never deferred, they often come right before `abort()` and must not be lost.
+#define FreeRTOSCpp_LogE(FORMAT, ...) \
+    ESP_LOGE("FreeRTOS-Cpp", FORMAT, ##__VA_ARGS__)
+#else
 #define FreeRTOSCpp_LogI(FORMAT, ...) \
     ESP_LOGI("FreeRTOS-Cpp", FORMAT, ##__VA_ARGS__)
 
@@ -15,6 +32,27 @@
 
 #define FreeRTOSCpp_LogE(FORMAT, ...) \
     ESP_LOGE("FreeRTOS-Cpp", FORMAT, ##__VA_ARGS__)
+#endif
+
+/**
+ * Scheduling hooks at the points where the interleaving of tasks matters (handle deletion, queue
+ * ownership transfer, mutex acquisition). They compile to nothing unless defined before the first
+ * include of this library, which lets a test harness force context switches there, see example `linux_sim`.
+ * Define them identically in every translation unit.
+ *
+ * `FREERTOS_CPP_SCHED_POINT(NAME)` marks a point where another task may run.
+ * `FREERTOS_CPP_SCHED_BLOCKING(NAME, CALL)` wraps a FreeRTOS call that may block and yields its result.
+ *
+ * A task whose function returns passes "task.return" and then, as the last point before it deletes
+ * or suspends itself for good, "task.exit".
+ */
+#ifndef FREERTOS_CPP_SCHED_POINT
+#define FREERTOS_CPP_SCHED_POINT(NAME) do {} while (0)
+#endif
+
+#ifndef FREERTOS_CPP_SCHED_BLOCKING
+#define FREERTOS_CPP_SCHED_BLOCKING(NAME, CALL) (CALL)
+#endif
 
 namespace augtons
 {
@@ -28,6 +66,22 @@ namespace augtons
         template<typename ArgType = void>
         class task_builder;
 
+        class stack_profiler;
+
+        class stop_token;
+
+        template<typename R>
+        class join_handle;
+
+        class periodic_task;
+
+        struct task_spec;
+
+        template<const task_spec&... Specs>
+        class static_task_set;
+
+        template<size_t Capacity = 32, size_t FunctorSize = 32>
+        class deferred_dispatcher;
     }
 
     namespace freertos {
@@ -67,6 +121,19 @@ namespace augtons {
     namespace freertos {
         template<typename T>
         class queue;
+
+        template<typename T>
+        class lease;
+
+        template<typename T, size_t N>
+        class resource_pool;
+
+        class stage_options;
+
+        template<typename T>
+        class pipeline_builder;
+
+        class pipeline;
     }
 }
 
@@ -0,0 +1,288 @@
+#ifndef FREERTOS_CPP_JOIN_HANDLE_HPP
+#define FREERTOS_CPP_JOIN_HANDLE_HPP
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <optional>
+#include "freertos.hpp"
+#include "semphr.hpp"
+
+namespace augtons {
+    namespace freertos {
+        namespace details {
+            class join_state_base {
+            private:
+                std::atomic<bool> stop_requested { false };
+                std::atomic<bool> finished { false };
+                binary_semphr done;     // Given by `finish()`, and given back by every `wait()` that takes it.
+
+            public:
+                void request_stop() {
+                    stop_requested.store(true);
+                }
+
+                bool is_stop_requested() const {
+                    return stop_requested.load();
+                }
+
+                bool is_finished() const {
+                    return finished.load();
+                }
+
+                // Called by the spawned task once its result is stored.
+                void finish() {
+                    finished.store(true);
+                    done.unlock();
+                }
+
+                // Blocks until `finish()` or timeout. The task notifications of the caller are left alone.
+                bool wait(TickType_t timeout) {
+                    if (is_finished()) {
+                        return true;
+                    }
+                    if (!done.lock(timeout)) {
+                        return false;
+                    }
+                    done.unlock();      // Let later and concurrent waiters through.
+                    return true;
+                }
+            };
+
+            template<typename R>
+            class join_state : public join_state_base {
+            private:
+                alignas(R) unsigned char storage[sizeof(R)];
+                bool has_value = false;
+
+            public:
+                join_state() = default;
+                join_state(const join_state&) = delete;
+                join_state& operator=(const join_state&) = delete;
+
+                ~join_state() {
+                    if (has_value) {
+                        reinterpret_cast<R*>(storage)->~R();
+                    }
+                }
+
+                void set_value(R&& value) {
+                    new (storage) R(std::move(value));
+                    has_value = true;
+                }
+
+                bool take_value(R& out) {
+                    if (!has_value) {
+                        return false;
+                    }
+                    R *value = reinterpret_cast<R*>(storage);
+                    out = std::move(*value);
+                    value->~R();
+                    has_value = false;
+                    return true;
+                }
+
+#if __cplusplus >= 201703L
+                std::optional<R> take_value() {
+                    if (!has_value) {
+                        return std::nullopt;
+                    }
+                    R *value = reinterpret_cast<R*>(storage);
+                    std::optional<R> out = std::move(*value);
+                    value->~R();
+                    has_value = false;
+                    return out;
+                }
+#endif
+            };
+
+            template<>
+            class join_state<void> : public join_state_base {};
+
+            template<typename F, typename = void>
+            struct accepts_stop_token : std::false_type {};
+
+            template<typename F>
+            struct accepts_stop_token<F, decltype((void)std::declval<F&>()(std::declval<stop_token>()))>
+                : std::true_type {};
+
+            template<typename F, bool = accepts_stop_token<F>::value>
+            struct spawn_result {
+                using type = decltype(std::declval<F&>()(std::declval<stop_token>()));
+            };
+
+            template<typename F>
+            struct spawn_result<F, false> {
+                using type = decltype(std::declval<F&>()());
+            };
+
+            template<typename R>
+            struct spawn_invoker {
+                template<typename F>
+                static void run(join_state<R>& state, F& func, const stop_token& token, std::true_type) {
+                    state.set_value(func(token));
+                }
+
+                template<typename F>
+                static void run(join_state<R>& state, F& func, const stop_token&, std::false_type) {
+                    state.set_value(func());
+                }
+            };
+
+            template<>
+            struct spawn_invoker<void> {
+                template<typename F>
+                static void run(join_state<void>&, F& func, const stop_token& token, std::true_type) {
+                    func(token);
+                }
+
+                template<typename F>
+                static void run(join_state<void>&, F& func, const stop_token&, std::false_type) {
+                    func();
+                }
+            };
+        }
+    }
+}
+
+/**
+ * Cooperative cancellation flag passed to functions started by `task_builder<>::spawn()`.
+ */
+class augtons::freertos::stop_token {
+private:
+    std::shared_ptr<const details::join_state_base> state = nullptr;
+
+public:
+    stop_token() = default;
+    explicit stop_token(std::shared_ptr<const details::join_state_base> state): state(std::move(state)) {}
+
+    inline bool stop_requested() const {
+        return state != nullptr && state->is_stop_requested();
+    }
+};
+
+/**
+ * Result of `task_builder<>::spawn()`. Owns the spawned task like `task<>` does,
+ * so the task is deleted when the handle is destroyed before it finishes.
+ */
+template<typename R>
+class augtons::freertos::join_handle {
+    friend class task_builder<void>;
+private:
+    task<> m_task;
+    std::shared_ptr<details::join_state<R>> m_state = nullptr;
+
+    join_handle(task<> t, std::shared_ptr<details::join_state<R>> state)
+        : m_task(std::move(t)), m_state(std::move(state)) {}
+
+public:
+    join_handle() = default;
+    join_handle(const join_handle&) = delete;
+    join_handle& operator=(const join_handle&) = delete;
+    join_handle(join_handle&&) noexcept = default;
+    join_handle& operator=(join_handle&&) noexcept = default;
+
+    inline bool valid() const {
+        return m_state != nullptr;
+    }
+
+    inline bool is_finished() const {
+        return valid() && m_state->is_finished();
+    }
+
+    inline void request_stop() {
+        if (valid()) {
+            m_state->request_stop();
+        }
+    }
+
+    inline const task<>& get_task() const {
+        return m_task;
+    }
+
+    /**
+     * Waits for the function to return without consuming its result.
+     */
+    bool wait(TickType_t timeout = portMAX_DELAY) {
+        if (!valid()) {
+            FreeRTOSCpp_LogW("Calling \"wait()\" on an invalid join handle.");
+            return false;
+        }
+        return m_state->wait(timeout);
+    }
+
+    /**
+     * Waits for the function to return and moves its result to `out`. The result can be taken once.
+     */
+    bool join_to(R& out, TickType_t timeout = portMAX_DELAY) {
+        if (!wait(timeout)) {
+            return false;
+        }
+        return m_state->take_value(out);
+    }
+
+#if __cplusplus >= 201703L
+    std::optional<R> join(TickType_t timeout = portMAX_DELAY) {
+        if (!wait(timeout)) {
+            return std::nullopt;
+        }
+        return m_state->take_value();
+    }
+#endif
+};
+
+template<>
+class augtons::freertos::join_handle<void> {
+    friend class task_builder<void>;
+private:
+    task<> m_task;
+    std::shared_ptr<details::join_state<void>> m_state = nullptr;
+
+    join_handle(task<> t, std::shared_ptr<details::join_state<void>> state)
+        : m_task(std::move(t)), m_state(std::move(state)) {}
+
+public:
+    join_handle() = default;
+    join_handle(const join_handle&) = delete;
+    join_handle& operator=(const join_handle&) = delete;
+    join_handle(join_handle&&) noexcept = default;
+    join_handle& operator=(join_handle&&) noexcept = default;
+
+    inline bool valid() const {
+        return m_state != nullptr;
+    }
+
+    inline bool is_finished() const {
+        return valid() && m_state->is_finished();
+    }
+
+    inline void request_stop() {
+        if (valid()) {
+            m_state->request_stop();
+        }
+    }
+
+    inline const task<>& get_task() const {
+        return m_task;
+    }
+
+    /**
+     * Waits for the function to return.
+     */
+    bool wait(TickType_t timeout = portMAX_DELAY) {
+        if (!valid()) {
+            FreeRTOSCpp_LogW("Calling \"wait()\" on an invalid join handle.");
+            return false;
+        }
+        return m_state->wait(timeout);
+    }
+
+    /**
+     * Same as `wait()`, there is no result to take.
+     */
+    bool join(TickType_t timeout = portMAX_DELAY) {
+        return wait(timeout);
+    }
+};
+
+#endif //FREERTOS_CPP_JOIN_HANDLE_HPP
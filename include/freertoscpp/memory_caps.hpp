@@ -0,0 +1,233 @@
+#ifndef FREERTOS_CPP_MEMORY_CAPS_HPP
+#define FREERTOS_CPP_MEMORY_CAPS_HPP
+
+#include <cstdlib>
+#include <new>
+#include <utility>
+#include "sdkconfig.h"
+#include "esp_idf_version.h"
+#if !defined(CONFIG_IDF_TARGET_LINUX) || __has_include("esp_heap_caps.h")
+#include "esp_heap_caps.h"      // On linux only for the `MALLOC_CAP_*` flags.
+#endif
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/timers.h"
+#include "freertos_types.hpp"
+
+// The linux target has a single heap and no heap_caps API, memory capabilities are ignored there.
+#ifdef CONFIG_IDF_TARGET_LINUX
+#define FREERTOS_CPP_HAS_HEAP_CAPS 0
+#else
+#define FREERTOS_CPP_HAS_HEAP_CAPS 1
+#endif
+
+// xTaskCreatePinnedToCoreWithCaps() and xQueueCreateWithCaps() appeared in ESP-IDF v5.1.
+#if FREERTOS_CPP_HAS_HEAP_CAPS && ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0)
+#define FREERTOS_CPP_HAS_WITH_CAPS 1
+#else
+#define FREERTOS_CPP_HAS_WITH_CAPS 0
+#endif
+
+namespace augtons {
+    namespace freertos {
+        namespace details {
+            // Capabilities actually requested from the heap, 0 where they are ignored.
+            inline uint32_t effective_caps(uint32_t caps) {
+                return FREERTOS_CPP_HAS_HEAP_CAPS ? caps : 0;
+            }
+
+            // `malloc()` from memory with capabilities `caps`, plain `malloc()` where capabilities are ignored.
+            inline void* caps_malloc(size_t size, uint32_t caps) {
+#if FREERTOS_CPP_HAS_HEAP_CAPS
+                return heap_caps_malloc(size, caps);
+#else
+                (void)caps;
+                return malloc(size);
+#endif
+            }
+
+            inline void caps_free(void *p) {
+#if FREERTOS_CPP_HAS_HEAP_CAPS
+                heap_caps_free(p);
+#else
+                free(p);
+#endif
+            }
+
+            /**
+             * Allocator for small, frequently used control blocks (shared data of `task` and `queue`).
+             * They always stay in internal RAM, even when `malloc()` may return PSRAM.
+             */
+            template<typename T>
+            struct internal_allocator {
+                using value_type = T;
+
+                internal_allocator() = default;
+
+                template<typename U>
+                internal_allocator(const internal_allocator<U>&) {}
+
+                T* allocate(size_t n) {
+#if FREERTOS_CPP_HAS_HEAP_CAPS
+                    void *p = caps_malloc(n * sizeof(T), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+#else
+                    void *p = caps_malloc(n * sizeof(T), 0);
+#endif
+                    if (p == nullptr) {
+                        FreeRTOSCpp_LogE("Out of internal memory.");
+                        abort();
+                    }
+                    return static_cast<T*>(p);
+                }
+
+                void deallocate(T* p, size_t) {
+                    caps_free(p);
+                }
+
+                template<typename U>
+                bool operator==(const internal_allocator<U>&) const {
+                    return true;
+                }
+
+                template<typename U>
+                bool operator!=(const internal_allocator<U>&) const {
+                    return false;
+                }
+            };
+
+            /**
+             * `new T(args...)` from memory with capabilities `caps`, or from the default heap when `caps` is 0.
+             * Returns nullptr if there is not enough memory with those capabilities.
+             */
+            template<typename T, typename... Args>
+            T* caps_new(uint32_t caps, Args&&... args) {
+                if (effective_caps(caps) == 0) {
+                    return new T(std::forward<Args>(args)...);
+                }
+                void *p = caps_malloc(sizeof(T), caps);
+                if (p == nullptr) {
+                    return nullptr;
+                }
+                return new (p) T(std::forward<Args>(args)...);
+            }
+
+            template<typename T>
+            void caps_delete(uint32_t caps, T* p) {
+                if (effective_caps(caps) == 0) {
+                    delete p;
+                    return;
+                }
+                p->~T();
+                caps_free(p);
+            }
+
+            /**
+             * Creates a task whose stack is allocated with capabilities `stack_caps` (0 for the default heap).
+             * The TCB always stays in internal RAM.
+             */
+            inline BaseType_t create_task(TaskFunction_t func, const char *name, uint32_t stack_size, void *arg,
+                                          UBaseType_t priority, TaskHandle_t *handle, BaseType_t core_id,
+                                          uint32_t stack_caps) {
+                if (effective_caps(stack_caps) == 0) {
+                    return xTaskCreatePinnedToCore(func, name, stack_size, arg, priority, handle, core_id);
+                }
+#if FREERTOS_CPP_HAS_WITH_CAPS
+                return xTaskCreatePinnedToCoreWithCaps(func, name, stack_size, arg, priority, handle, core_id, stack_caps);
+#else
+                FreeRTOSCpp_LogE("Task stack capabilities need ESP-IDF v5.1 or later.");
+                return pdFAIL;
+#endif
+            }
+
+            /**
+             * `vTaskDelete()` of a task running on the other core returns before that core has switched
+             * away from it. Suspends the task and waits until it is off the CPU, so that memory it uses
+             * can be freed right after deleting it. Must not be called on the current task.
+             */
+            inline void stop_task(TaskHandle_t handle) {
+#if portNUM_PROCESSORS > 1
+                vTaskSuspend(handle);
+                while (eTaskGetState(handle) == eRunning) {
+                    // The other core switches away at its next yield interrupt.
+                }
+#else
+                (void)handle;
+#endif
+            }
+
+#if FREERTOS_CPP_HAS_WITH_CAPS
+            /**
+             * Pended to the timer service task by a task deleting itself. The stack is freed, so the task
+             * must have switched away from it: wait until it has suspended itself.
+             *
+             * Waiting blocks instead of re-pending or yielding. The task may run below the timer priority
+             * on this core, and only blocking the timer task lets it reach `vTaskSuspend()`.
+             */
+            inline void delete_suspended_task(void *h, uint32_t) {
+                TaskHandle_t handle = static_cast<TaskHandle_t>(h);
+                while (eTaskGetState(handle) != eSuspended) {
+                    vTaskDelay(1);
+                }
+                vTaskDeleteWithCaps(handle);
+            }
+#endif
+
+            /**
+             * Deletes a task created by `create_task()`.
+             *
+             * Another task is stopped first, see `stop_task()`. This also matters for caps-allocated stacks:
+             * depending on the IDF version, `vTaskDeleteWithCaps()` frees the stack right after `vTaskDelete()`,
+             * which would still be in use by a task running on the other core.
+             *
+             * A task with a caps-allocated stack cannot free its own stack, so deleting itself is handed
+             * to the timer service task and this never returns.
+             */
+            inline void delete_task(TaskHandle_t handle, uint32_t stack_caps) {
+                bool self = handle == xTaskGetCurrentTaskHandle();
+                if (!self) {
+                    stop_task(handle);
+                }
+                if (effective_caps(stack_caps) == 0) {
+                    vTaskDelete(handle);
+                    return;
+                }
+#if FREERTOS_CPP_HAS_WITH_CAPS
+                if (!self) {
+                    vTaskDeleteWithCaps(handle);
+                    return;
+                }
+                xTimerPendFunctionCall(delete_suspended_task, handle, 0, portMAX_DELAY);
+                while (true) {
+                    vTaskSuspend(nullptr);
+                }
+#endif
+            }
+
+            inline QueueHandle_t create_queue(UBaseType_t length, UBaseType_t item_size, uint32_t storage_caps) {
+                if (effective_caps(storage_caps) == 0) {
+                    return xQueueCreate(length, item_size);
+                }
+#if FREERTOS_CPP_HAS_WITH_CAPS
+                return xQueueCreateWithCaps(length, item_size, storage_caps);
+#else
+                FreeRTOSCpp_LogE("Queue storage capabilities need ESP-IDF v5.1 or later.");
+                return nullptr;
+#endif
+            }
+
+            inline void delete_queue(QueueHandle_t handle, uint32_t storage_caps) {
+#if FREERTOS_CPP_HAS_WITH_CAPS
+                if (effective_caps(storage_caps) != 0) {
+                    vQueueDeleteWithCaps(handle);
+                    return;
+                }
+#endif
+                (void)storage_caps;
+                vQueueDelete(handle);
+            }
+        }
+    }
+}
+
+#endif //FREERTOS_CPP_MEMORY_CAPS_HPP
@@ -0,0 +1,156 @@
+#ifndef FREERTOS_CPP_MPSC_RING_HPP
+#define FREERTOS_CPP_MPSC_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace augtons {
+    namespace freertos {
+        namespace details {
+            /**
+             * Bounded lock-free ring with many producers and one consumer, preallocated and
+             * usable from ISRs. Each cell carries a sequence number telling whether it is free
+             * for the producer of round `pos` or filled for the consumer.
+             */
+            template<typename T, size_t Capacity>
+            class mpsc_ring {
+                static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two.");
+            private:
+                struct cell {
+                    std::atomic<size_t> sequence { 0 };
+                    T value {};
+                };
+
+                cell cells[Capacity];
+                std::atomic<size_t> enqueue_pos { 0 };
+                std::atomic<size_t> dequeue_pos { 0 };
+
+            public:
+                mpsc_ring() {
+                    for (size_t i = 0; i < Capacity; i++) {
+                        cells[i].sequence.store(i, std::memory_order_relaxed);
+                    }
+                }
+
+                mpsc_ring(const mpsc_ring&) = delete;
+                mpsc_ring& operator=(const mpsc_ring&) = delete;
+
+                static constexpr size_t capacity() {
+                    return Capacity;
+                }
+
+                /**
+                 * Reserves a cell and fills it with `fill(T&)`. Returns false when the ring is full.
+                 */
+                template<typename Fill>
+                bool try_push(Fill&& fill) {
+                    cell *c = nullptr;
+                    size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+                    while (true) {
+                        c = &cells[pos & (Capacity - 1)];
+                        size_t seq = c->sequence.load(std::memory_order_acquire);
+                        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+                        if (diff == 0) {
+                            if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                                break;
+                            }
+                        } else if (diff < 0) {
+                            return false;
+                        } else {
+                            pos = enqueue_pos.load(std::memory_order_relaxed);
+                        }
+                    }
+                    fill(c->value);
+                    c->sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+
+                /**
+                 * Hands the oldest element to `consume(T&)` and frees its cell. Consumer side only.
+                 */
+                template<typename Consume>
+                bool try_pop(Consume&& consume) {
+                    size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+                    cell *c = &cells[pos & (Capacity - 1)];
+                    size_t seq = c->sequence.load(std::memory_order_acquire);
+                    if ((intptr_t)seq - (intptr_t)(pos + 1) < 0) {
+                        return false;
+                    }
+                    dequeue_pos.store(pos + 1, std::memory_order_relaxed);
+                    consume(c->value);
+                    c->sequence.store(pos + Capacity, std::memory_order_release);
+                    return true;
+                }
+
+                /**
+                 * True if the next element is not published yet. Consumer side only.
+                 */
+                bool empty() const {
+                    size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+                    const cell *c = &cells[pos & (Capacity - 1)];
+                    return (intptr_t)c->sequence.load(std::memory_order_acquire) - (intptr_t)(pos + 1) < 0;
+                }
+
+                /**
+                 * Approximate number of reserved cells.
+                 */
+                size_t size() const {
+                    return enqueue_pos.load(std::memory_order_relaxed) - dequeue_pos.load(std::memory_order_relaxed);
+                }
+            };
+
+            /**
+             * Type-erased `void()` callable stored inline, never allocates.
+             */
+            template<size_t Size>
+            class small_function {
+            private:
+                alignas(alignof(std::max_align_t)) unsigned char storage[Size];
+                void (*invoke_fn)(void*) = nullptr;
+                void (*destroy_fn)(void*) = nullptr;
+
+            public:
+                small_function() = default;
+                small_function(const small_function&) = delete;
+                small_function& operator=(const small_function&) = delete;
+
+                ~small_function() {
+                    reset();
+                }
+
+                template<typename F>
+                void emplace(F&& func) {
+                    using Fn = typename std::decay<F>::type;
+                    static_assert(sizeof(Fn) <= Size, "Callable is too large, increase the functor size.");
+                    static_assert(alignof(Fn) <= alignof(std::max_align_t), "Callable is over-aligned.");
+                    reset();
+                    new (storage) Fn(std::forward<F>(func));
+                    invoke_fn = [](void *p) { (*static_cast<Fn*>(p))(); };
+                    destroy_fn = [](void *p) { static_cast<Fn*>(p)->~Fn(); };
+                }
+
+                void reset() {
+                    if (destroy_fn != nullptr) {
+                        destroy_fn(storage);
+                    }
+                    invoke_fn = nullptr;
+                    destroy_fn = nullptr;
+                }
+
+                inline explicit operator bool() const {
+                    return invoke_fn != nullptr;
+                }
+
+                void operator()() {
+                    invoke_fn(storage);
+                }
+            };
+        }
+    }
+}
+
+#endif //FREERTOS_CPP_MPSC_RING_HPP
@@ -0,0 +1,187 @@
+#ifndef FREERTOS_CPP_PERIODIC_HPP
+#define FREERTOS_CPP_PERIODIC_HPP
+
+#include <memory>
+#include "esp_timer.h"
+#include "freertos.hpp"
+
+namespace augtons {
+    namespace freertos {
+        /**
+         * Timing statistics of a task started by `task_builder<>::bind_periodic()`. All times in microseconds.
+         *
+         * Histogram bucket 0 counts 0 us, bucket `i` counts [2^(i-1), 2^i) us and the last bucket everything above.
+         */
+        struct periodic_stats {
+            static constexpr size_t buckets = 16;
+
+            uint32_t activations = 0;
+            uint32_t overruns = 0;          // Activations that did not finish before the next one was due.
+            uint32_t missed = 0;            // Activations skipped to get back onto the period grid.
+            uint32_t exec_min = UINT32_MAX;
+            uint32_t exec_max = 0;
+            uint64_t exec_total = 0;
+            uint32_t jitter_max = 0;        // Lateness of the start relative to the ideal release time.
+            uint64_t jitter_total = 0;
+            uint32_t exec_histogram[buckets] = {0};
+            uint32_t jitter_histogram[buckets] = {0};
+
+            static size_t bucket_of(uint32_t us) {
+                if (us == 0) {
+                    return 0;
+                }
+                size_t bucket = 32 - __builtin_clz(us);
+                return bucket < buckets ? bucket : buckets - 1;
+            }
+        };
+
+        namespace details {
+            class periodic_state {
+            private:
+                mutable portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+                periodic_stats stats;
+
+            public:
+                const TickType_t period;
+
+                explicit periodic_state(TickType_t period): period(period) {}
+
+                void record(uint32_t exec, uint32_t jitter) {
+                    portENTER_CRITICAL(&lock);
+                    stats.activations++;
+                    stats.exec_min = exec < stats.exec_min ? exec : stats.exec_min;
+                    stats.exec_max = exec > stats.exec_max ? exec : stats.exec_max;
+                    stats.exec_total += exec;
+                    stats.jitter_max = jitter > stats.jitter_max ? jitter : stats.jitter_max;
+                    stats.jitter_total += jitter;
+                    stats.exec_histogram[periodic_stats::bucket_of(exec)]++;
+                    stats.jitter_histogram[periodic_stats::bucket_of(jitter)]++;
+                    portEXIT_CRITICAL(&lock);
+                }
+
+                // Known only once the next release is due, after the activation has been recorded.
+                void record_overrun(uint32_t missed) {
+                    portENTER_CRITICAL(&lock);
+                    stats.overruns++;
+                    stats.missed += missed;
+                    portEXIT_CRITICAL(&lock);
+                }
+
+                periodic_stats snapshot() const {
+                    portENTER_CRITICAL(&lock);
+                    periodic_stats copy = stats;
+                    portEXIT_CRITICAL(&lock);
+                    return copy;
+                }
+
+                void reset() {
+                    portENTER_CRITICAL(&lock);
+                    stats = periodic_stats();
+                    portEXIT_CRITICAL(&lock);
+                }
+            };
+
+            /**
+             * Calls `func` every `state.period` ticks with `xTaskDelayUntil()`, so execution time does not
+             * accumulate as drift. After an overrun the missed activations are skipped instead of run back to back.
+             */
+            template<typename Func>
+            void run_periodic(periodic_state& state, const Func& func) {
+                const TickType_t period = state.period;
+                const int64_t period_us = (int64_t)period * 1000000 / configTICK_RATE_HZ;
+
+                // Start on a tick boundary: later activations wake on ticks, so `release` must lie on
+                // the same grid or every lateness would be under-reported by the offset into the tick.
+                TickType_t last_wake = xTaskGetTickCount();
+                xTaskDelayUntil(&last_wake, 1);
+                int64_t release = esp_timer_get_time();
+                while (true) {
+                    int64_t start = esp_timer_get_time();
+                    func();
+                    int64_t end = esp_timer_get_time();
+
+                    // Recorded before sleeping, so `stats()` includes the activation that just ran.
+                    int64_t lateness = start - release;
+                    state.record((uint32_t)(end - start), lateness > 0 ? (uint32_t)lateness : 0);
+
+                    uint32_t missed = 0;
+                    if (xTaskDelayUntil(&last_wake, period) == pdFALSE) {
+                        // `last_wake` is now the release that was due. pdFALSE also means it is the current
+                        // tick, which is on time: only an activation that ended past that tick overran.
+                        TickType_t now = xTaskGetTickCount();
+                        if (now != last_wake) {
+                            while ((TickType_t)(now - last_wake) >= period) {
+                                last_wake += period;
+                                missed++;
+                            }
+                            state.record_overrun(missed);
+                        }
+                    }
+                    release += period_us * (1 + missed);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * A task started by `task_builder<>::bind_periodic()`, with its timing statistics.
+ * Like `task<>`, the task is deleted when the last copy is destroyed.
+ */
+class augtons::freertos::periodic_task {
+    friend class task_builder<void>;
+private:
+    task<> m_task;
+    std::shared_ptr<details::periodic_state> m_state = nullptr;
+
+    periodic_task(task<> t, std::shared_ptr<details::periodic_state> state)
+        : m_task(std::move(t)), m_state(std::move(state)) {}
+
+public:
+    periodic_task() = default;
+
+    inline bool is_null() const {
+        return m_task.is_null();
+    }
+
+    inline const task<>& get_task() const {
+        return m_task;
+    }
+
+    inline TickType_t period() const {
+        return m_state == nullptr ? 0 : m_state->period;
+    }
+
+    periodic_stats stats() const {
+        if (m_state == nullptr) {
+            return periodic_stats();
+        }
+        return m_state->snapshot();
+    }
+
+    void reset_stats() {
+        if (m_state != nullptr) {
+            m_state->reset();
+        }
+    }
+
+    void dump(const char *name) const {
+        periodic_stats s = stats();
+        uint32_t n = s.activations == 0 ? 1 : s.activations;
+        FreeRTOSCpp_LogI("%s: %lu activations, %lu overruns, %lu missed",
+                         name, (unsigned long)s.activations, (unsigned long)s.overruns, (unsigned long)s.missed);
+        FreeRTOSCpp_LogI("%s: exec us min/avg/max = %lu/%lu/%lu, jitter us avg/max = %lu/%lu", name,
+                         (unsigned long)(s.activations == 0 ? 0 : s.exec_min), (unsigned long)(s.exec_total / n),
+                         (unsigned long)s.exec_max, (unsigned long)(s.jitter_total / n), (unsigned long)s.jitter_max);
+        for (size_t i = 0; i < periodic_stats::buckets; i++) {
+            if (s.exec_histogram[i] == 0 && s.jitter_histogram[i] == 0) {
+                continue;
+            }
+            FreeRTOSCpp_LogI("%s: < %7lu us  exec %8lu  jitter %8lu", name,
+                             i + 1 < periodic_stats::buckets ? (unsigned long)(1u << i) : (unsigned long)UINT32_MAX,
+                             (unsigned long)s.exec_histogram[i], (unsigned long)s.jitter_histogram[i]);
+        }
+    }
+};
+
+#endif //FREERTOS_CPP_PERIODIC_HPP
@@ -0,0 +1,473 @@
+#ifndef FREERTOS_CPP_PIPELINE_HPP
+#define FREERTOS_CPP_PIPELINE_HPP
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "esp_timer.h"
+#include "freertos.hpp"
+#include "freertos_task_factory.hpp"
+#include "queue.hpp"
+#include "semphr.hpp"
+
+/**
+ * Where and how a pipeline stage runs, and the depth of the channel feeding it.
+ */
+class augtons::freertos::stage_options {
+    template<typename T> friend class pipeline_builder;
+    friend class pipeline;
+private:
+    uint32_t m_stack_size_num = 2048;
+    UBaseType_t m_priority = 1;
+    BaseType_t m_core_id = tskNO_AFFINITY;
+    size_t m_depth = 4;
+    bool m_fused = false;
+
+public:
+    stage_options& stack(uint32_t size) {
+        this->m_stack_size_num = size;
+        return *this;
+    }
+
+    stage_options& priority(UBaseType_t p) {
+        this->m_priority = p;
+        return *this;
+    }
+
+    stage_options& core_id(BaseType_t core) {
+        this->m_core_id = core;
+        return *this;
+    }
+
+    /**
+     * Number of items the channel in front of this stage can hold before the previous stage blocks.
+     */
+    stage_options& depth(size_t d) {
+        this->m_depth = d;
+        return *this;
+    }
+
+    /**
+     * Runs this stage in the task of the previous stage, without a channel in between.
+     * Worth it when a stage is cheap compared to a queue hand-over and a context switch.
+     * Priority, core and depth are then taken from the previous stage.
+     */
+    stage_options& fuse(bool fused = true) {
+        this->m_fused = fused;
+        return *this;
+    }
+};
+
+namespace augtons {
+    namespace freertos {
+        struct pipeline_stage_stats {
+            const char *name;
+            uint32_t items;
+            uint64_t busy_us;       // Time spent in the stage function.
+        };
+
+        struct pipeline_channel_stats {
+            const char *consumer;   // Name of the stage reading from the channel.
+            size_t depth;
+            size_t occupancy;
+            size_t peak;
+            uint32_t blocked;       // Sends that found the channel full (backpressure).
+        };
+
+        namespace details {
+            template<typename T>
+            struct channel_item {
+                bool end = false;   // End of stream, the producing segment has finished.
+                T value {};
+            };
+
+            struct pipeline_stage_record {
+                char name[CONFIG_FREERTOS_MAX_TASK_NAME_LEN + 1] = {0};
+                uint32_t items = 0;
+                uint64_t busy_us = 0;
+            };
+
+            struct pipeline_channel_record {
+                const pipeline_stage_record *consumer = nullptr;
+                size_t depth = 0;
+                QueueHandle_t handle = nullptr;
+                size_t peak = 0;
+                uint32_t blocked = 0;
+            };
+
+            struct pipeline_segment {
+                stage_options options;
+                const pipeline_stage_record *first = nullptr;
+                std::function<void()> body;
+            };
+
+            struct pipeline_graph {
+                portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+                std::vector<std::unique_ptr<pipeline_stage_record>> stages;
+                std::vector<std::unique_ptr<pipeline_channel_record>> channels;
+                std::vector<pipeline_segment> segments;
+                std::atomic<size_t> finished { 0 };
+                binary_semphr done;             // Given by the last segment to finish, and by `pipeline::stop()`.
+                bool stopped = false;           // The channels may hold items of the stopped run.
+                int64_t started_at = 0;
+
+                pipeline_stage_record* add_stage(const char *name) {
+                    stages.emplace_back(new pipeline_stage_record());
+                    strncpy(stages.back()->name, name, sizeof(stages.back()->name) - 1);
+                    return stages.back().get();
+                }
+
+                void account(pipeline_stage_record *stage, int64_t busy_us) {
+                    portENTER_CRITICAL(&lock);
+                    stage->items++;
+                    stage->busy_us += busy_us;
+                    portEXIT_CRITICAL(&lock);
+                }
+
+                // Blocks while the channel is full, which is how backpressure reaches the producer.
+                // Fails only when the item cannot be allocated.
+                template<typename T>
+                bool send(pipeline_channel_record *channel, const queue<channel_item<T>>& q, channel_item<T>&& item) {
+                    bool full = uxQueueSpacesAvailable(channel->handle) == 0;
+                    if (q.send(std::move(item)) != pdPASS) {
+                        return false;
+                    }
+                    size_t waiting = uxQueueMessagesWaiting(channel->handle);
+                    portENTER_CRITICAL(&lock);
+                    channel->blocked += full ? 1 : 0;
+                    channel->peak = waiting > channel->peak ? waiting : channel->peak;
+                    portEXIT_CRITICAL(&lock);
+                    return true;
+                }
+            };
+        }
+    }
+}
+
+/**
+ * A pipeline under construction whose last stage produces `T`. See `pipeline`.
+ */
+template<typename T>
+class augtons::freertos::pipeline_builder {
+    template<typename U> friend class pipeline_builder;
+    friend class pipeline;
+private:
+    using pull_fn = std::function<bool(T&)>;
+    using graph_ptr = std::shared_ptr<details::pipeline_graph>;
+
+    graph_ptr graph;
+    pull_fn pull;                                           // Produces the next item inside the current segment.
+    stage_options segment_options;
+    const details::pipeline_stage_record *segment_first;    // Names the task of the current segment.
+
+    pipeline_builder(graph_ptr graph, pull_fn pull, const stage_options& options,
+                     const details::pipeline_stage_record *first)
+        : graph(std::move(graph)), pull(std::move(pull)), segment_options(options), segment_first(first) {}
+
+    /**
+     * Ends the current segment with a channel and returns the puller reading from that channel.
+     */
+    pull_fn split(const details::pipeline_stage_record *consumer, const stage_options& options) {
+        auto *g = graph.get();
+        queue<details::channel_item<T>> q(options.m_depth);
+
+        g->channels.emplace_back(new details::pipeline_channel_record());
+        auto *channel = g->channels.back().get();
+        channel->consumer = consumer;
+        channel->depth = options.m_depth;
+        channel->handle = q.native_handle();
+
+        pull_fn producer = std::move(pull);
+        g->segments.push_back({ segment_options, segment_first, [g, channel, q, producer]() {
+            while (true) {
+                details::channel_item<T> item;
+                item.end = !producer(item.value);
+                bool end = item.end;
+                bool sent = g->send(channel, q, std::move(item));
+                if (end) {
+                    // Every later stage and `wait()` depend on the end marker, it must not be lost.
+                    while (!sent) {
+                        vTaskDelay(1);
+                        details::channel_item<T> marker;
+                        marker.end = true;
+                        sent = g->send(channel, q, std::move(marker));
+                    }
+                    return;
+                }
+            }
+        } });
+
+        return [q](T& out) {
+            details::channel_item<T> item;
+            if (!q.receive_to(item) || item.end) {
+                return false;
+            }
+            out = std::move(item.value);
+            return true;
+        };
+    }
+
+    /**
+     * Input puller and segment of a new stage: a new segment behind a channel, or the current one when fused.
+     */
+    pull_fn input_of(details::pipeline_stage_record *stage, const stage_options& options,
+                     stage_options& seg_options, const details::pipeline_stage_record *& seg_first) {
+        if (options.m_fused) {
+            seg_options = segment_options;
+            if (options.m_stack_size_num > seg_options.m_stack_size_num) {
+                seg_options.m_stack_size_num = options.m_stack_size_num;
+            }
+            seg_first = segment_first;
+            return std::move(pull);
+        }
+        seg_options = options;
+        seg_first = stage;
+        return split(stage, options);
+    }
+
+public:
+    /**
+     * Adds a stage transforming each `T` into `func(T&&)`.
+     */
+    template<typename F>
+    auto then(const char *name, F func, const stage_options& options = stage_options())
+        -> pipeline_builder<decltype(func(std::declval<T&&>()))> {
+        using U = decltype(func(std::declval<T&&>()));
+
+        auto *g = graph.get();
+        auto *stage = g->add_stage(name);
+        stage_options seg_options;
+        const details::pipeline_stage_record *seg_first = nullptr;
+        pull_fn input = input_of(stage, options, seg_options, seg_first);
+
+        std::function<bool(U&)> next = [g, stage, input, func](U& out) mutable {
+            T in;
+            if (!input(in)) {
+                return false;
+            }
+            int64_t start = esp_timer_get_time();
+            out = func(std::move(in));
+            g->account(stage, esp_timer_get_time() - start);
+            return true;
+        };
+        return pipeline_builder<U>(std::move(graph), std::move(next), seg_options, seg_first);
+    }
+
+    /**
+     * Adds the last stage, consuming each `T` with `func(T&&)`, and returns the finished pipeline.
+     */
+    template<typename F>
+    pipeline sink(const char *name, F func, const stage_options& options = stage_options());
+};
+
+/**
+ * Stages connected by bounded channels, declared in one place.
+ *
+ * Every stage runs in its own task unless it is fused into the previous one, and the channel
+ * in front of it blocks the producer when full. A source returning false ends the stream,
+ * which then propagates through all stages and finishes every task.
+ *
+ * ```
+ * auto p = pipeline::source<frame>("capture", [](frame& out) { return camera_read(out); },
+ *                                  stage_options().priority(5).core_id(1))
+ *     .then("filter", [](frame&& f) { return denoise(f); }, stage_options().depth(2))
+ *     .then("encode", [](frame&& f) { return encode(f); }, stage_options().stack(8192))
+ *     .sink("transmit", [](packet&& p) { send(p); }, stage_options().core_id(0));
+ * p.start();
+ * p.report();
+ * ```
+ *
+ * Items are passed by value through channels, so every type must be default constructible and movable.
+ */
+class augtons::freertos::pipeline {
+    template<typename T> friend class pipeline_builder;
+private:
+    std::shared_ptr<details::pipeline_graph> graph;
+    std::vector<task<>> tasks;   // Declared after graph, so tasks are deleted before the graph is freed.
+
+    explicit pipeline(std::shared_ptr<details::pipeline_graph> graph): graph(std::move(graph)) {}
+
+public:
+    pipeline() = default;
+    pipeline(const pipeline&) = delete;
+    pipeline& operator=(const pipeline&) = delete;
+    pipeline(pipeline&&) noexcept = default;
+    pipeline& operator=(pipeline&&) noexcept = default;
+
+    /**
+     * Starts a pipeline with a source stage. `func(T& out)` fills the next item and returns false at end of stream.
+     */
+    template<typename T, typename F>
+    static pipeline_builder<T> source(const char *name, F func, const stage_options& options = stage_options()) {
+        auto graph = std::make_shared<details::pipeline_graph>();
+        auto *g = graph.get();
+        auto *stage = g->add_stage(name);
+        std::function<bool(T&)> pull = [g, stage, func](T& out) mutable {
+            int64_t start = esp_timer_get_time();
+            bool more = func(out);
+            if (more) {
+                g->account(stage, esp_timer_get_time() - start);
+            }
+            return more;
+        };
+        return pipeline_builder<T>(std::move(graph), std::move(pull), options, stage);
+    }
+
+    inline bool is_null() const {
+        return graph == nullptr;
+    }
+
+    /**
+     * Number of tasks the pipeline runs in, after fusing.
+     */
+    inline size_t task_count() const {
+        return is_null() ? 0 : graph->segments.size();
+    }
+
+    bool start() {
+        if (is_null() || !tasks.empty()) {
+            FreeRTOSCpp_LogW("Try to start a pipeline that is null or already started.");
+            return false;
+        }
+        if (graph->stopped) {
+            FreeRTOSCpp_LogW("A stopped pipeline cannot be restarted, its channels hold items of the previous run.");
+            return false;
+        }
+        graph->started_at = esp_timer_get_time();
+        for (auto& segment : graph->segments) {
+            auto *g = graph.get();
+            auto body = segment.body;
+            task<> t = task_builder<>(segment.first->name)
+                .stack(segment.options.m_stack_size_num)
+                .priority(segment.options.m_priority)
+                .core_id(segment.options.m_core_id)
+                .bind([g, body]() {
+                    body();
+                    if (++g->finished == g->segments.size()) {
+                        g->done.unlock();
+                    }
+                });
+            if (t.is_null()) {
+                FreeRTOSCpp_LogE("Failed to create pipeline task \"%s\".", segment.first->name);
+                stop();
+                return false;
+            }
+            tasks.push_back(std::move(t));
+        }
+        return true;
+    }
+
+    /**
+     * Deletes all tasks immediately. Items in flight inside a stage are lost, prefer ending the stream at the source.
+     * A stopped pipeline cannot be started again.
+     */
+    void stop() {
+        tasks.clear();
+        if (!is_null()) {
+            graph->stopped = true;
+            graph->done.unlock();   // Wakes `wait()`, which then sees the stream did not finish.
+        }
+    }
+
+    /**
+     * Whether the pipeline has been started and not stopped. It stays running after the stream has finished.
+     */
+    inline bool is_running() const {
+        return !is_null() && !tasks.empty();
+    }
+
+    inline bool is_finished() const {
+        return is_running() && graph->finished.load() == graph->segments.size();
+    }
+
+    /**
+     * Waits until the end of stream has passed through every stage.
+     * Returns false on timeout, when the pipeline is not running or when it is stopped meanwhile.
+     */
+    bool wait(TickType_t timeout = portMAX_DELAY) {
+        if (!is_running()) {
+            return false;
+        }
+        if (!graph->done.lock(timeout)) {
+            return false;
+        }
+        graph->done.unlock();       // Let other and later waiters through.
+        return graph->finished.load() == graph->segments.size();
+    }
+
+    size_t stage_count() const {
+        return is_null() ? 0 : graph->stages.size();
+    }
+
+    pipeline_stage_stats stage_stats(size_t index) const {
+        auto *stage = graph->stages[index].get();
+        portENTER_CRITICAL(&graph->lock);
+        pipeline_stage_stats stats { stage->name, stage->items, stage->busy_us };
+        portEXIT_CRITICAL(&graph->lock);
+        return stats;
+    }
+
+    size_t channel_count() const {
+        return is_null() ? 0 : graph->channels.size();
+    }
+
+    pipeline_channel_stats channel_stats(size_t index) const {
+        auto *channel = graph->channels[index].get();
+        size_t occupancy = tasks.empty() ? 0 : uxQueueMessagesWaiting(channel->handle);
+        portENTER_CRITICAL(&graph->lock);
+        pipeline_channel_stats stats { channel->consumer->name, channel->depth, occupancy, channel->peak, channel->blocked };
+        portEXIT_CRITICAL(&graph->lock);
+        return stats;
+    }
+
+    /**
+     * Logs throughput and busy time of every stage and occupancy of every channel.
+     * The busiest stage is the bottleneck; a channel that is often full sits in front of a slow stage.
+     */
+    void report() const {
+        if (is_null()) {
+            return;
+        }
+        int64_t elapsed = esp_timer_get_time() - graph->started_at;
+        if (elapsed <= 0) {
+            elapsed = 1;
+        }
+        FreeRTOSCpp_LogI("%-*s %10s %10s %6s", CONFIG_FREERTOS_MAX_TASK_NAME_LEN, "stage", "items", "items/s", "busy%");
+        for (size_t i = 0; i < stage_count(); i++) {
+            auto s = stage_stats(i);
+            FreeRTOSCpp_LogI("%-*s %10lu %10lu %6lu", CONFIG_FREERTOS_MAX_TASK_NAME_LEN, s.name, (unsigned long)s.items,
+                             (unsigned long)((uint64_t)s.items * 1000000 / elapsed),
+                             (unsigned long)(s.busy_us * 100 / elapsed));
+        }
+        FreeRTOSCpp_LogI("%-*s %10s %10s %6s", CONFIG_FREERTOS_MAX_TASK_NAME_LEN, "channel to", "occupancy", "peak", "full");
+        for (size_t i = 0; i < channel_count(); i++) {
+            auto c = channel_stats(i);
+            FreeRTOSCpp_LogI("%-*s %7lu/%-2lu %10lu %6lu", CONFIG_FREERTOS_MAX_TASK_NAME_LEN, c.consumer,
+                             (unsigned long)c.occupancy, (unsigned long)c.depth, (unsigned long)c.peak,
+                             (unsigned long)c.blocked);
+        }
+    }
+};
+
+template<typename T>
+template<typename F>
+auto augtons::freertos::pipeline_builder<T>::sink(const char *name, F func, const stage_options& options) -> pipeline {
+    auto *g = graph.get();
+    auto *stage = g->add_stage(name);
+    stage_options seg_options;
+    const details::pipeline_stage_record *seg_first = nullptr;
+    pull_fn input = input_of(stage, options, seg_options, seg_first);
+
+    g->segments.push_back({ seg_options, seg_first, [g, stage, input, func]() mutable {
+        T item;
+        while (input(item)) {
+            int64_t start = esp_timer_get_time();
+            func(std::move(item));
+            g->account(stage, esp_timer_get_time() - start);
+        }
+    } });
+    return pipeline(std::move(graph));
+}
+
+#endif //FREERTOS_CPP_PIPELINE_HPP
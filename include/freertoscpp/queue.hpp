@@ -5,6 +5,7 @@
 #ifndef FREERTOS_CPP_QUEUE_HPP
 #define FREERTOS_CPP_QUEUE_HPP
 
+#include <atomic>
 #include <optional>
 #include "freertos.hpp"
 #include "freertos/queue.h"
@@ -13,8 +14,28 @@ namespace augtons {
     namespace freertos {
         namespace details {
             struct queue_shared_data {
-                bool has_deleted = false;
+                std::atomic<bool> has_deleted { false };
                 QueueHandle_t handle = nullptr;
+                uint32_t storage_caps = 0;  // 0: queue storage from the default heap.
+                uint32_t payload_caps = 0;  // 0: messages from the default heap.
+                void (*drain)(QueueHandle_t, uint32_t) = nullptr;   // Frees the messages still in the queue.
+
+                // Deletes the queue exactly once, see `delete_task_once()`.
+                void delete_once() {
+                    FREERTOS_CPP_SCHED_POINT("queue.delete");
+                    if (handle == nullptr || has_deleted.exchange(true)) {
+                        return;
+                    }
+                    if (drain != nullptr) {
+                        drain(handle, payload_caps);
+                    }
+                    details::delete_queue(handle, storage_caps);
+                }
+
+                // Runs once, when the last `queue<>` referring to it is destroyed.
+                ~queue_shared_data() {
+                    delete_once();
+                }
             };
         }
 
@@ -28,45 +49,69 @@ class augtons::freertos::queue {
     static_assert(!std::is_reference<T>::value, "Don't support reference type.");
 private:
     queue_shared_data_ptr shared_data = nullptr;
+
+    static void drain(QueueHandle_t handle, uint32_t payload_caps) {
+        T* data = nullptr;
+        while (xQueueReceive(handle, &data, 0) == pdTRUE) {
+            details::caps_delete(payload_caps, data);
+        }
+    }
+
+    BaseType_t send_new(T* new_data, TickType_t timeout) const {
+        if (new_data == nullptr) {
+            FreeRTOSCpp_LogE("Out of memory for a queue message.");
+            return pdFAIL;
+        }
+        if (FREERTOS_CPP_SCHED_BLOCKING("queue.send", xQueueSend(shared_data->handle, &new_data, timeout)) != pdTRUE) {
+            details::caps_delete(shared_data->payload_caps, new_data);
+            return pdFAIL;
+        }
+        return pdPASS;
+    }
+
 public:
 
     queue() = default;
 
-    explicit queue(size_t length) {
-        shared_data = std::make_shared<details::queue_shared_data>();
-        shared_data->handle = xQueueCreate(sizeof(PointerType), length); // 用指针，记得特化引用
+    explicit queue(size_t length) : queue(length, 0, 0) {}
+
+    /**
+     * Places the queue storage and the messages in memory with the given capabilities, e.g.
+     * `queue<frame>(8, 0, MALLOC_CAP_SPIRAM)` keeps the queue in internal RAM and puts the frames in PSRAM.
+     * 0 means the default heap. `storage_caps` needs ESP-IDF v5.1.
+     */
+    queue(size_t length, uint32_t storage_caps, uint32_t payload_caps) {
+        shared_data = std::allocate_shared<details::queue_shared_data>(details::internal_allocator<details::queue_shared_data>());
+        shared_data->handle = details::create_queue(length, sizeof(PointerType), storage_caps); // 用指针，记得特化引用
+        shared_data->storage_caps = storage_caps;
+        shared_data->payload_caps = payload_caps;
+        shared_data->drain = drain;
     }
 
-    queue(queue&) = default;
+    queue(const queue&) = default;
     queue(queue&&) noexcept = default;
     queue& operator=(const queue&) = default;
     queue& operator=(queue&&) noexcept = default;
 
     queue& operator=(nullptr_t) {
-        this->~queue();
+        shared_data = nullptr;
         return *this;
     }
 
-    ~queue() {
-        if (is_null()) {
-            return;
-        }
-        if (shared_data.use_count() <= 1 && !(shared_data->has_deleted)) {
-            delete_queue();
-        }
-        shared_data = nullptr;
-    }
+    // The queue is deleted by `~queue_shared_data()` when the last owner goes away,
+    // with the same thread-safety rules as `task`.
+    ~queue() = default;
 
     inline bool is_null() const {
-        return shared_data == nullptr || shared_data->handle == nullptr;
+        return shared_data == nullptr || shared_data->handle == nullptr || shared_data->has_deleted.load();
     }
 
     inline bool has_deleted() const {
-        if (is_null()) {
+        if (shared_data == nullptr || shared_data->handle == nullptr) {
             FreeRTOSCpp_LogW("Calling \"has_deleted()\" on a null queue object always returns true.");
             return true;
         }
-        return shared_data->has_deleted;
+        return shared_data->has_deleted.load();
     }
 
     void delete_queue() {
@@ -74,15 +119,10 @@ public:
             FreeRTOSCpp_LogW("Try to delete a queue from a queue object that is null.");
             return;
         }
-        if (has_deleted()) {
-            shared_data = nullptr;
-            return;
-        }
 
-        vQueueDelete(shared_data->handle);
-        shared_data->handle = nullptr;
-        shared_data->has_deleted = true;
+        auto data = std::move(shared_data);
         shared_data = nullptr;
+        data->delete_once();
     }
 
     inline long use_count() const {
@@ -133,19 +173,17 @@ public:
         if (is_null() || has_deleted()) {
             return pdFAIL;
         }
-        T* new_data = new T(std::move(data));    // 重新new一次，通过移动右值来延长生命周期(C+17前)
-                                                 // 重新new一次，将临时量实质化(C++17起)用于传入队列
-        assert(new_data);
-        return xQueueSend(shared_data->handle, &new_data, timeout);
+        T* new_data = details::caps_new<T>(shared_data->payload_caps, std::move(data));  // 重新new一次，通过移动右值来延长生命周期(C+17前)
+                                                                                       // 重新new一次，将临时量实质化(C++17起)用于传入队列
+        return send_new(new_data, timeout);
     }
 
     BaseType_t send(T& data, TickType_t timeout = portMAX_DELAY) const { // 不要加const
         if (is_null() || has_deleted()) {
             return pdFAIL;
         }
-        auto *new_data = new T(data);    // 重新new保证正确拷贝
-        assert(new_data);
-        return xQueueSend(shared_data->handle, &new_data, timeout);
+        auto *new_data = details::caps_new<T>(shared_data->payload_caps, data);    // 重新new保证正确拷贝
+        return send_new(new_data, timeout);
     }
 
     bool receive_to(T& out, TickType_t timeout = portMAX_DELAY) const {
@@ -153,10 +191,11 @@ public:
             return false;
         }
         T* new_data = nullptr;
-        if (xQueueReceive(shared_data->handle, &new_data, timeout) == pdTRUE) {
+        if (FREERTOS_CPP_SCHED_BLOCKING("queue.receive", xQueueReceive(shared_data->handle, &new_data, timeout)) == pdTRUE) {
             assert(new_data);
+            FREERTOS_CPP_SCHED_POINT("queue.receive.take");
             out = std::move(*new_data);
-            delete new_data;
+            details::caps_delete(shared_data->payload_caps, new_data);
             return true;
         } else {
             return false;
@@ -169,10 +208,11 @@ public:
             return std::nullopt;
         }
         T* new_data = nullptr;
-        if (xQueueReceive(shared_data->handle, &new_data, timeout) == pdTRUE) {
+        if (FREERTOS_CPP_SCHED_BLOCKING("queue.receive", xQueueReceive(shared_data->handle, &new_data, timeout)) == pdTRUE) {
             assert(new_data);
+            FREERTOS_CPP_SCHED_POINT("queue.receive.take");
             T out = std::move(*new_data);
-            delete new_data;
+            details::caps_delete(shared_data->payload_caps, new_data);
             return out;
         } else {
             return std::nullopt;
@@ -0,0 +1,220 @@
+#ifndef FREERTOS_CPP_RESOURCE_POOL_HPP
+#define FREERTOS_CPP_RESOURCE_POOL_HPP
+
+#include <atomic>
+#include "freertos.hpp"
+#include "semphr.hpp"
+
+namespace augtons {
+    namespace freertos {
+        namespace details {
+            template<typename T>
+            class lease_owner {
+            public:
+                virtual void release(size_t index) = 0;
+
+            protected:
+                ~lease_owner() = default;
+            };
+        }
+    }
+}
+
+/**
+ * Exclusive access to one element of a `resource_pool`, given back to the pool on destruction.
+ */
+template<typename T>
+class augtons::freertos::lease {
+    template<typename U, size_t N> friend class resource_pool;
+private:
+    details::lease_owner<T> *owner = nullptr;
+    T *item = nullptr;
+    size_t m_index = 0;
+
+    lease(details::lease_owner<T> *owner, T *item, size_t index)
+        : owner(owner), item(item), m_index(index) {}
+
+public:
+    lease() = default;
+
+    /* Disable Copy */
+    lease(const lease&) = delete;
+    lease& operator=(const lease&) = delete;
+
+    /* Enable Move */
+    lease(lease&& other) noexcept
+        : owner(other.owner), item(other.item), m_index(other.m_index) {
+        other.owner = nullptr;
+        other.item = nullptr;
+    }
+
+    lease& operator=(lease&& other) noexcept {
+        if (this == &other) {
+            return *this;
+        }
+        release();
+        owner = other.owner;
+        item = other.item;
+        m_index = other.m_index;
+        other.owner = nullptr;
+        other.item = nullptr;
+        return *this;
+    }
+
+    ~lease() {
+        release();
+    }
+
+    /**
+     * Gives the element back to the pool early.
+     */
+    void release() {
+        if (owner != nullptr) {
+            owner->release(m_index);
+            owner = nullptr;
+            item = nullptr;
+        }
+    }
+
+    inline bool is_null() const {
+        return item == nullptr;
+    }
+
+    inline explicit operator bool() const {
+        return item != nullptr;
+    }
+
+    inline size_t index() const {
+        return m_index;
+    }
+
+    inline T* get() const {
+        return item;
+    }
+
+    inline T& operator*() const {
+        return *item;
+    }
+
+    inline T* operator->() const {
+        return item;
+    }
+};
+
+/**
+ * A fixed pool of `N` (at most 32) elements handed out as `lease<T>`.
+ *
+ * Free elements are tracked in one atomic bit mask, so acquiring and releasing cost a single
+ * compare-and-swap when an element is available. Only callers that have to wait use a semaphore.
+ * Leases must be released in task context.
+ *
+ * ```
+ * static resource_pool<dma_buffer, 4> buffers;
+ *
+ * auto buffer = buffers.acquire(pdMS_TO_TICKS(10));
+ * if (buffer) {
+ *     fill(buffer->data);
+ * }   // Returned to the pool here.
+ * ```
+ */
+template<typename T, size_t N>
+class augtons::freertos::resource_pool : private details::lease_owner<T> {
+    static_assert(N > 0 && N <= 32, "resource_pool supports 1 to 32 elements.");
+private:
+    T items[N];
+    std::atomic<uint32_t> free_mask { N == 32 ? UINT32_MAX : (1u << N) - 1 };
+    std::atomic<uint32_t> waiters { 0 };
+    counting_semphr wakeup { N, 0 };
+
+    bool try_take(size_t& index) {
+        uint32_t mask = free_mask.load();
+        while (mask != 0) {
+            uint32_t bit = mask & (~mask + 1);
+            if (free_mask.compare_exchange_weak(mask, mask & ~bit)) {
+                index = __builtin_ctz(bit);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void release(size_t index) override {
+        free_mask.fetch_or(1u << index);
+        if (waiters.load() > 0) {
+            wakeup.unlock();
+        }
+    }
+
+public:
+    resource_pool() = default;
+
+    /**
+     * Initializes every element with `init(T& item, size_t index)`.
+     */
+    template<typename Init>
+    explicit resource_pool(Init init) {
+        for (size_t i = 0; i < N; i++) {
+            init(items[i], i);
+        }
+    }
+
+    // Leases refer to this object.
+    resource_pool(const resource_pool&) = delete;
+    resource_pool& operator=(const resource_pool&) = delete;
+
+    static constexpr size_t capacity() {
+        return N;
+    }
+
+    inline size_t available() const {
+        return __builtin_popcount(free_mask.load());
+    }
+
+    /**
+     * Returns a null lease if no element is free.
+     */
+    lease<T> try_acquire() {
+        size_t index = 0;
+        if (try_take(index)) {
+            return lease<T>(this, &items[index], index);
+        }
+        return lease<T>();
+    }
+
+    /**
+     * Waits up to `timeout` for a free element. Returns a null lease on timeout.
+     */
+    lease<T> acquire(TickType_t timeout = portMAX_DELAY) {
+        size_t index = 0;
+        if (try_take(index)) {
+            return lease<T>(this, &items[index], index);
+        }
+        if (timeout == 0) {
+            return lease<T>();
+        }
+
+        TimeOut_t time_out;
+        vTaskSetTimeOutState(&time_out);
+        waiters++;
+        bool taken = false;
+        while (true) {
+            // Retry after registering as waiter, a release in between would not have signalled us.
+            if (try_take(index)) {
+                taken = true;
+                break;
+            }
+            if (xTaskCheckForTimeOut(&time_out, &timeout) != pdFALSE) {
+                break;
+            }
+            wakeup.lock(timeout);
+        }
+        waiters--;
+
+        if (!taken) {
+            return lease<T>();
+        }
+        return lease<T>(this, &items[index], index);
+    }
+};
+
+#endif //FREERTOS_CPP_RESOURCE_POOL_HPP
@@ -33,6 +33,7 @@ public:
     mutex_locker(mutex_locker&&) noexcept = delete;
 
     ~mutex_locker() {
+        FREERTOS_CPP_SCHED_POINT("mutex_locker.unlock");
         mutex.unlock();
     }
 };
@@ -74,7 +75,8 @@ public:                                                         \
     }                                                           \
                                                                 \
     bool lock(TickType_t timeout = portMAX_DELAY) {             \
-        return _Take(mutex, timeout);                           \
+        return FREERTOS_CPP_SCHED_BLOCKING(#_ClassName ".lock", \
+            _Take(mutex, timeout));                             \
     }                                                           \
                                                                 \
     void unlock() {                                             \
@@ -132,7 +134,7 @@ public:
     }
 
     bool lock(TickType_t timeout = portMAX_DELAY) {
-        return xSemaphoreTake(mutex, timeout);
+        return FREERTOS_CPP_SCHED_BLOCKING("counting_semphr.lock", xSemaphoreTake(mutex, timeout));
     }
 
     void unlock() {
@@ -0,0 +1,180 @@
+#ifndef FREERTOS_CPP_STACK_PROFILER_HPP
+#define FREERTOS_CPP_STACK_PROFILER_HPP
+
+#include <cstring>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos_types.hpp"
+
+#ifndef CONFIG_FREERTOS_CPP_STACK_AUTO_MARGIN
+#define CONFIG_FREERTOS_CPP_STACK_AUTO_MARGIN 512
+#endif
+
+namespace augtons {
+    namespace freertos {
+        struct stack_usage {
+            char name[CONFIG_FREERTOS_MAX_TASK_NAME_LEN + 1] = {0};
+            uint32_t stack_size = 0;    // Stack size the task was created with (same unit as `stack()`).
+            uint32_t max_used = 0;      // Peak usage over all samples.
+            uint32_t samples = 0;
+        };
+    }
+}
+
+/**
+ * Records the peak stack usage of tasks created by `task_factory`, keyed by task name.
+ *
+ * Only active when `CONFIG_FREERTOS_CPP_STACK_PROFILER` is enabled, otherwise every
+ * function is a no-op and `lookup()` always fails.
+ */
+class augtons::freertos::stack_profiler {
+public:
+    static constexpr bool enabled() {
+#ifdef CONFIG_FREERTOS_CPP_STACK_PROFILER
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    static void record(TaskHandle_t handle, uint32_t stack_size) {
+#ifdef CONFIG_FREERTOS_CPP_STACK_PROFILER
+        if (handle == nullptr || stack_size == 0) {
+            return;
+        }
+        const char *name = pcTaskGetName(handle);
+        uint32_t free_min = uxTaskGetStackHighWaterMark(handle);
+        uint32_t used = stack_size > free_min ? stack_size - free_min : 0;
+
+        auto& t = table();
+        bool full = false;
+        portENTER_CRITICAL(&t.lock);
+        stack_usage *slot = find_locked(name);
+        if (slot == nullptr) {
+            if (t.count < CONFIG_FREERTOS_CPP_STACK_PROFILER_SLOTS) {
+                slot = &t.entries[t.count++];
+                strncpy(slot->name, name, sizeof(slot->name) - 1);
+            } else {
+                full = true;
+            }
+        }
+        if (slot != nullptr) {
+            slot->stack_size = stack_size;
+            if (used > slot->max_used) {
+                slot->max_used = used;
+            }
+            slot->samples++;
+        }
+        portEXIT_CRITICAL(&t.lock);
+
+        if (full) {
+            FreeRTOSCpp_LogW("Stack profiler is full, \"%s\" is not recorded. Increase CONFIG_FREERTOS_CPP_STACK_PROFILER_SLOTS.", name);
+        } else {
+            FreeRTOSCpp_LogD("Stack of \"%s\": %lu/%lu used.", name, (unsigned long)used, (unsigned long)stack_size);
+        }
+#else
+        (void)handle;
+        (void)stack_size;
+#endif
+    }
+
+    /**
+     * Samples a running task now, without waiting for it to be deleted.
+     */
+    template<typename Arg>
+    static void sample(const task<Arg>& t) {
+        record(t.native_handle(), t.stack_size());
+    }
+
+    static bool lookup(const char *name, stack_usage& out) {
+#ifdef CONFIG_FREERTOS_CPP_STACK_PROFILER
+        auto& t = table();
+        bool found = false;
+        portENTER_CRITICAL(&t.lock);
+        stack_usage *slot = find_locked(name);
+        if (slot != nullptr) {
+            out = *slot;
+            found = true;
+        }
+        portEXIT_CRITICAL(&t.lock);
+        return found;
+#else
+        (void)name;
+        (void)out;
+        return false;
+#endif
+    }
+
+    /**
+     * Stack size for a task named `name`: recorded peak usage plus `margin`, rounded up to 16.
+     * Returns `fallback` if nothing has been recorded for that name.
+     */
+    static uint32_t suggest(const char *name, uint32_t fallback,
+                            uint32_t margin = CONFIG_FREERTOS_CPP_STACK_AUTO_MARGIN) {
+        stack_usage usage;
+        if (!lookup(name, usage)) {
+            return fallback;
+        }
+        uint32_t size = (usage.max_used + margin + 15) & ~15u;
+        return size < configMINIMAL_STACK_SIZE ? configMINIMAL_STACK_SIZE : size;
+    }
+
+    static void dump() {
+#ifdef CONFIG_FREERTOS_CPP_STACK_PROFILER
+        auto& t = table();
+        FreeRTOSCpp_LogI("%-*s %8s %8s %8s %8s", CONFIG_FREERTOS_MAX_TASK_NAME_LEN, "task", "stack", "peak", "samples", "suggest");
+        for (size_t i = 0; ; i++) {
+            stack_usage usage;
+            portENTER_CRITICAL(&t.lock);
+            bool valid = i < t.count;
+            if (valid) {
+                usage = t.entries[i];
+            }
+            portEXIT_CRITICAL(&t.lock);
+            if (!valid) {
+                break;
+            }
+            FreeRTOSCpp_LogI("%-*s %8lu %8lu %8lu %8lu", CONFIG_FREERTOS_MAX_TASK_NAME_LEN, usage.name,
+                             (unsigned long)usage.stack_size, (unsigned long)usage.max_used,
+                             (unsigned long)usage.samples, (unsigned long)suggest(usage.name, 0));
+        }
+#else
+        FreeRTOSCpp_LogW("Stack profiler is disabled, enable CONFIG_FREERTOS_CPP_STACK_PROFILER.");
+#endif
+    }
+
+    static void reset() {
+#ifdef CONFIG_FREERTOS_CPP_STACK_PROFILER
+        auto& t = table();
+        portENTER_CRITICAL(&t.lock);
+        t.count = 0;
+        portEXIT_CRITICAL(&t.lock);
+#endif
+    }
+
+#ifdef CONFIG_FREERTOS_CPP_STACK_PROFILER
+private:
+    struct usage_table {
+        portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+        size_t count = 0;
+        stack_usage entries[CONFIG_FREERTOS_CPP_STACK_PROFILER_SLOTS];
+    };
+
+    static usage_table& table() {
+        static usage_table t;
+        return t;
+    }
+
+    static stack_usage* find_locked(const char *name) {
+        auto& t = table();
+        for (size_t i = 0; i < t.count; i++) {
+            if (strncmp(t.entries[i].name, name, sizeof(t.entries[i].name) - 1) == 0) {
+                return &t.entries[i];
+            }
+        }
+        return nullptr;
+    }
+#endif
+};
+
+#endif //FREERTOS_CPP_STACK_PROFILER_HPP
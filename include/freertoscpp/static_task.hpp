@@ -0,0 +1,168 @@
+#ifndef FREERTOS_CPP_STATIC_TASK_HPP
+#define FREERTOS_CPP_STATIC_TASK_HPP
+
+#include <atomic>
+#include <initializer_list>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos_types.hpp"
+
+namespace augtons {
+    namespace freertos {
+        /**
+         * Compile-time description of a long-lived task, used with `static_task_set`.
+         *
+         * ```
+         * constexpr task_spec blink { "blink", 2048, 1, 0, blink_entry };
+         * ```
+         */
+        struct task_spec {
+            const char *name;
+            uint32_t stack_size;
+            UBaseType_t priority;
+            BaseType_t core_id;
+            void (*entry)();
+        };
+
+        namespace details {
+            constexpr size_t const_strlen(const char *str) {
+                return *str == '\0' ? 0 : 1 + const_strlen(str + 1);
+            }
+
+            constexpr bool all_of(std::initializer_list<bool> values) {
+                for (bool v : values) {
+                    if (!v) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            constexpr bool pairwise_distinct(std::initializer_list<const task_spec*> specs) {
+                for (auto a = specs.begin(); a != specs.end(); a++) {
+                    for (auto b = a + 1; b != specs.end(); b++) {
+                        if (*a == *b) {
+                            return false;
+                        }
+                    }
+                }
+                return true;
+            }
+
+            template<const task_spec& Spec>
+            struct static_task_check {
+                static_assert(Spec.name != nullptr,
+                              "task_spec: name must not be null.");
+                static_assert(const_strlen(Spec.name) < CONFIG_FREERTOS_MAX_TASK_NAME_LEN,
+                              "task_spec: name is longer than CONFIG_FREERTOS_MAX_TASK_NAME_LEN - 1.");
+                static_assert(Spec.stack_size >= configMINIMAL_STACK_SIZE,
+                              "task_spec: stack_size is smaller than configMINIMAL_STACK_SIZE.");
+                static_assert(Spec.priority < configMAX_PRIORITIES,
+                              "task_spec: priority must be less than configMAX_PRIORITIES.");
+                static_assert(Spec.core_id == tskNO_AFFINITY || (Spec.core_id >= 0 && Spec.core_id < portNUM_PROCESSORS),
+                              "task_spec: core_id must be tskNO_AFFINITY or a valid core.");
+                static_assert(Spec.entry != nullptr,
+                              "task_spec: entry must not be null.");
+                static constexpr bool value = true;
+            };
+
+            template<const task_spec& Spec>
+            struct static_task_storage {
+                static StaticTask_t tcb;
+                static StackType_t stack[Spec.stack_size];
+                static TaskHandle_t handle;
+
+                static void task_fun(void*) {
+                    Spec.entry();
+                    vTaskDelete(nullptr);
+                }
+
+                // The TCB and the stack belong to the spec, so it can be created once, whichever set starts it.
+                static TaskHandle_t create() {
+                    static std::atomic<bool> created { false };
+                    if (created.exchange(true)) {
+                        FreeRTOSCpp_LogE("Static task \"%s\" has already been created.", Spec.name);
+                        return nullptr;
+                    }
+                    handle = xTaskCreateStaticPinnedToCore(task_fun, Spec.name, Spec.stack_size, nullptr,
+                                                           Spec.priority, stack, &tcb, Spec.core_id);
+                    if (handle == nullptr) {
+                        FreeRTOSCpp_LogE("Failed to create static task \"%s\".", Spec.name);
+                    }
+                    return handle;
+                }
+            };
+
+            template<const task_spec& Spec>
+            StaticTask_t static_task_storage<Spec>::tcb;
+
+            template<const task_spec& Spec>
+            StackType_t static_task_storage<Spec>::stack[Spec.stack_size];
+
+            template<const task_spec& Spec>
+            TaskHandle_t static_task_storage<Spec>::handle = nullptr;
+        }
+    }
+}
+
+/**
+ * A fixed set of tasks whose configuration is checked at compile time and whose stacks and TCBs
+ * are allocated statically, so starting them needs no heap.
+ *
+ * ```
+ * constexpr task_spec blink  { "blink",  2048, 1, 0, blink_entry };
+ * constexpr task_spec sensor { "sensor", 3072, 5, tskNO_AFFINITY, sensor_entry };
+ *
+ * using boot_tasks = static_task_set<blink, sensor>;
+ * boot_tasks::start();
+ * ```
+ *
+ * When an entry function returns, its task deletes itself. The set can be started only once,
+ * and a `task_spec` can be started by only one set.
+ */
+template<const augtons::freertos::task_spec&... Specs>
+class augtons::freertos::static_task_set {
+    static_assert(sizeof...(Specs) > 0, "static_task_set needs at least one task_spec.");
+
+    static_assert(details::all_of({ details::static_task_check<Specs>::value... }),
+                  "Invalid task_spec in static_task_set.");
+
+    static_assert(details::pairwise_distinct({ &Specs... }),
+                  "static_task_set: the same task_spec is listed twice.");
+
+public:
+    static_task_set() = delete;
+
+    static constexpr size_t size() {
+        return sizeof...(Specs);
+    }
+
+    /**
+     * Creates every task of the set. Returns false if any of them could not be created,
+     * or if the set or one of its specs has been started before.
+     */
+    static bool start() {
+        static std::atomic<bool> started { false };
+        if (started.exchange(true)) {
+            FreeRTOSCpp_LogW("static_task_set has already been started.");
+            return false;
+        }
+        TaskHandle_t handles[] = { details::static_task_storage<Specs>::create()... };
+        for (auto handle : handles) {
+            if (handle == nullptr) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Native handle of the task described by `Spec`, or nullptr before `start()`.
+     */
+    template<const task_spec& Spec>
+    static TaskHandle_t native_handle() {
+        return details::static_task_storage<Spec>::handle;
+    }
+};
+
+#endif //FREERTOS_CPP_STATIC_TASK_HPP